@@ -0,0 +1,238 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+
+#ifndef __DiffusionGroup_hpp
+#define __DiffusionGroup_hpp
+
+#include <climits>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include "SpatiocyteCommon.hpp"
+#include "SpatiocyteSpecies.hpp"
+#include "SpatiocyteProcessInterface.hpp"
+#include "DiffusionProcessInterface.hpp"
+
+//The DiffusionProcesses with the same step interval share a single entry in
+//the priority queue and walk their species in one sweep. The molecules of
+//the species are visited in a random merge of the molecule lists, i.e.,
+//the next molecule is taken from a species with the probability of its
+//share of the molecules that have not been walked yet, so that no species
+//always walks (and collides) before the others. Species that are large
+//enough for the threaded walk are still walked on their own, before the
+//sweep.
+class DiffusionGroup: public SpatiocyteProcessInterface
+{
+public:
+  DiffusionGroup(const gsl_rng* aRng, Time aStepInterval):
+    thePriority(INT_MIN),
+    theTime(libecs::INF),
+    theStepInterval(aStepInterval),
+    theRng(aRng),
+    thePriorityQueue(NULL) {}
+  virtual ~DiffusionGroup() {}
+  virtual void initializeSecond() {}
+  virtual void initializeThird() {}
+  virtual void initializeFourth() {}
+  virtual void initializeLastOnce() {}
+  virtual void printParameters()
+    {
+      std::cout << "DiffusionGroup" << std::endl;
+      std::cout << "  species:" << theSpecies.size() << 
+        " diffusion interval:" << theStepInterval << std::endl;
+    }
+  virtual void substrateValueChanged(Time) {}
+  virtual void setPriorityQueue(ProcessPriorityQueue* aPriorityQueue)
+    {
+      thePriorityQueue = aPriorityQueue;
+    }
+  virtual void setTime(Time aTime)
+    {
+      theTime = aTime;
+    }
+  virtual Time getTime() const
+    {
+      return theTime;
+    }
+  //The group is executed with the highest priority of its processes at
+  //the same time:
+  virtual int getQueuePriority() const
+    {
+      return thePriority;
+    }
+  virtual void setQueueID(ProcessID anID)
+    {
+      theQueueID = anID;
+    }
+  virtual void addSubstrateInterrupt(Species*, Voxel*) {}
+  virtual void removeSubstrateInterrupt(Species*, Voxel*) {}
+  Time getStepInterval() const
+    {
+      return theStepInterval;
+    }
+  unsigned int size() const
+    {
+      return theSpecies.size();
+    }
+  void addProcess(DiffusionProcessInterface* aProcess)
+    {
+      aProcess->setDiffusionGroup(this);
+      theSpecies.push_back(aProcess->getDiffusionSpecies());
+      theCursors.push_back(0);
+      addPriority(dynamic_cast<SpatiocyteProcessInterface*>(aProcess));
+    }
+  //Must be called before the group is pushed into the priority queue:
+  void initialize(Time aCurrentTime)
+    {
+      theTime = libecs::INF;
+      if(!isEmpty())
+        {
+          theTime = aCurrentTime+theStepInterval;
+        }
+    }
+  //Called by a DiffusionProcess when its species is no longer empty:
+  void addMolecules(Time aCurrentTime)
+    {
+      if(theTime == libecs::INF)
+        {
+          theTime = aCurrentTime+theStepInterval;
+          thePriorityQueue->move(theQueueID);
+        }
+    }
+  //Called by a DiffusionProcess when its species has become empty:
+  void removeMolecules()
+    {
+      if(theTime != libecs::INF && isEmpty())
+        {
+          theTime = libecs::INF;
+          thePriorityQueue->move(theQueueID);
+        }
+    }
+  virtual void fire()
+    {
+      for(unsigned int i(0); i != theSpecies.size(); ++i)
+        {
+          theSpecies[i]->resetFinalizeReactions();
+          theCursors[i] = 0;
+          //Walk the large species with the threads, and skip them in the
+          //sweep:
+          if(theSpecies[i]->getIsThreadedWalk())
+            {
+              theSpecies[i]->walk();
+              theCursors[i] = UINT_MAX;
+            }
+          else
+            {
+              theSpecies[i]->prepareWalk();
+            }
+        }
+      sweep();
+      for(unsigned int i(0); i != theSpecies.size(); ++i)
+        {
+          theSpecies[i]->finalizeReactions();
+        }
+      theTime += theStepInterval;
+      thePriorityQueue->moveTop();
+    }
+private:
+  bool isEmpty() const
+    {
+      for(unsigned int i(0); i != theSpecies.size(); ++i)
+        {
+          if(theSpecies[i]->size())
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  //The species of the molecules are drawn from a shuffled sequence that
+  //holds each species once per molecule, which is a random merge of the
+  //molecule lists. The molecule lists can change during the sweep because
+  //of the diffusion-influenced reactions, so the molecules that have not
+  //been walked when the sequence is exhausted are walked at the end:
+  void sweep()
+    {
+      theSequence.clear();
+      for(unsigned int i(0); i != theSpecies.size(); ++i)
+        {
+          if(theCursors[i] != UINT_MAX)
+            {
+              theSequence.insert(theSequence.end(), theSpecies[i]->size(), i);
+            }
+        }
+      if(theSequence.size() > 1)
+        {
+          gsl_ran_shuffle(theRng, &theSequence[0], theSequence.size(),
+                          sizeof(unsigned int));
+        }
+      for(std::vector<unsigned int>::const_iterator i(theSequence.begin());
+          i != theSequence.end(); ++i)
+        {
+          walkNext(*i);
+        }
+      for(unsigned int i(0); i != theSpecies.size(); ++i)
+        {
+          while(theCursors[i] < theSpecies[i]->size())
+            {
+              walkNext(i);
+            }
+        }
+    }
+  void walkNext(unsigned int anIndex)
+    {
+      //The cursor stays if a reaction has moved another molecule into
+      //the index of the walked molecule:
+      if(theCursors[anIndex] < theSpecies[anIndex]->size() &&
+         !theSpecies[anIndex]->walkMolecule(theCursors[anIndex]))
+        {
+          ++theCursors[anIndex];
+        }
+    }
+  void addPriority(SpatiocyteProcessInterface* aProcess)
+    {
+      if(aProcess && aProcess->getQueuePriority() > thePriority)
+        {
+          thePriority = aProcess->getQueuePriority();
+        }
+    }
+private:
+  int thePriority;
+  Time theTime;
+  Time theStepInterval;
+  const gsl_rng* theRng;
+  ProcessID theQueueID;
+  ProcessPriorityQueue* thePriorityQueue; 
+  std::vector<Species*> theSpecies;
+  std::vector<unsigned int> theCursors;
+  std::vector<unsigned int> theSequence;
+};
+
+#endif /* __DiffusionGroup_hpp */
@@ -55,189 +55,311 @@ void DiffusionInfluencedReactionProcess::initializeSecond()
 
 void DiffusionInfluencedReactionProcess::initializeThird()
 {
+  setReactMethod();
+}
+
+//A product can take the voxel of a reactant if it is in the same Comp,
+//i.e., the product has the same vacant species as the reactant or the
+//reactant is the vacant species of the product:
+bool DiffusionInfluencedReactionProcess::isSameComp(Species* aReactant,
+                                                    Species* aProduct)
+{
+  return aReactant->getVacantID() == aProduct->getVacantID() ||
+    aReactant->getID() == aProduct->getVacantID();
 }
 
 //Do the reaction A + B -> C + D. So that A <- C and B <- D.
-//We need to consider that the source molecule can be either A or B.
 //If A and C belong to the same Comp, A <- C.
 //Otherwise, find a vacant adjoining voxel of A, X which is the same Comp
 //as C and X <- C.
 //Similarly, if B and D belong to the same Comp, B <- D.
 //Otherwise, find a vacant adjoining voxel of C, Y which is the same Comp
 //as D and Y <- D.
-bool DiffusionInfluencedReactionProcess::react(Voxel* moleculeA,
-                                               Voxel* moleculeB)
+//The species and Comps of the reactants and products do not change after
+//initialization, so the shape of the reaction is resolved here once
+//instead of on every collision:
+void DiffusionInfluencedReactionProcess::setReactMethod()
 {
-  //First let us make sure moleculeA and moleculeB belong to the
-  //correct species.
-  if(moleculeA->id != A->getID())
-    {
-      Voxel* tempA(moleculeA);
-      moleculeA = moleculeB;
-      moleculeB = tempA;
-    }
   //nonHD_A + nonHD_B -> nonHD_C + HD_D:
   //nonHD_A + nonHD_B -> HD_C + nonHD_D:
   if((variableC && D) || (C && variableD))
     {
-      Variable* HD_p(variableC);
-      Species* nonHD_p(D);
+      theHDProduct = variableC;
+      theNonHDProduct = D;
       if(variableD)
         {
-          HD_p = variableD;
-          nonHD_p = C;
+          theHDProduct = variableD;
+          theNonHDProduct = C;
         }
-      Voxel* moleculeP;
-      if(A->getVacantID() == nonHD_p->getVacantID() ||
-         A->getID() == nonHD_p->getVacantID())
+      if(isSameComp(A, theNonHDProduct))
         {
-          moleculeP = moleculeA;
-          //Hard remove the B molecule, since nonHD_p is in a different Comp:
-          moleculeB->id = B->getVacantID();
+          theReactMethod = &DiffusionInfluencedReactionProcess::
+            reactHDAndNonHDAtA;
         }
-      else if(B->getVacantID() == nonHD_p->getVacantID() ||
-              B->getID() == nonHD_p->getVacantID())
+      else if(isSameComp(B, theNonHDProduct))
         {
-          moleculeP = moleculeB;
-          //Hard remove the A molecule, since nonHD_p is in a different Comp:
-          moleculeA->id = A->getVacantID();
+          theReactMethod = &DiffusionInfluencedReactionProcess::
+            reactHDAndNonHDAtB;
         }
       else
-        { 
-          moleculeP = nonHD_p->getRandomAdjoiningVoxel(moleculeA);
-          //Only proceed if we can find an adjoining vacant voxel
-          //of A which can be occupied by C:
-          if(moleculeP == NULL)
-            {
-              moleculeP = nonHD_p->getRandomAdjoiningVoxel(moleculeB);
-              if(moleculeP == NULL)
-                {
-                  return false;
-                }
-            }
-          //Hard remove the A molecule, since nonHD_p is in a different Comp:
-          moleculeA->id = A->getVacantID();
-          //Hard remove the B molecule, since nonHD_p is in a different Comp:
-          moleculeB->id = B->getVacantID();
+        {
+          theReactMethod = &DiffusionInfluencedReactionProcess::
+            reactHDAndAdjoiningNonHD;
         }
-      HD_p->addValue(1);
-      nonHD_p->addMolecule(moleculeP);
-      return true;
     }
   //nonHD_A + nonHD_B -> HD_C:
   else if(variableC && !D && !variableD)
     {
-
-      //Hard remove the A molecule, since nonHD_p is in a different Comp:
-      moleculeA->id = A->getVacantID();
-      //Hard remove the B molecule, since nonHD_p is in a different Comp:
-      moleculeB->id = B->getVacantID();
-      variableC->addValue(1);
-      return true;
+      theReactMethod = &DiffusionInfluencedReactionProcess::reactHD;
     }
-
-  Voxel* moleculeC;
-  Voxel* moleculeD;
-  if(A->getVacantID() == C->getVacantID() || A->getID() == C->getVacantID())
+  else if(isSameComp(A, C))
     {
-      moleculeC = moleculeA;
-      if(D)
+      if(!D)
         {
-          if(B->getVacantID() == D->getVacantID() ||
-             B->getID() == D->getVacantID())
-            {
-              moleculeD = moleculeB;
-            }
-          else
-            {
-              moleculeD = D->getRandomAdjoiningVoxel(moleculeC, moleculeC);
-              if(moleculeD == NULL)
-                {
-                  return false;
-                }
-              moleculeB->id = B->getVacantID();
-            }
-          D->addMolecule(moleculeD);
+          theReactMethod = &DiffusionInfluencedReactionProcess::reactCAtA;
+        }
+      else if(isSameComp(B, D))
+        {
+          theReactMethod = &DiffusionInfluencedReactionProcess::reactCAtADAtB;
         }
       else
         {
-          //Hard remove the B molecule since it is not used:
-          moleculeB->id = B->getVacantID();
+          theReactMethod = &DiffusionInfluencedReactionProcess::
+            reactCAtAAdjoiningD;
         }
     }
-  else if(B->getVacantID() == C->getVacantID() ||
-          B->getID() == C->getVacantID())
+  else if(isSameComp(B, C))
     {
-      moleculeC = moleculeB;
-      if(D)
+      if(!D)
         {
-          if(A->getVacantID() == D->getVacantID() ||
-             A->getID() == D->getVacantID())
-            {
-              moleculeD = moleculeA;
-            }
-          else
-            {
-              moleculeD = D->getRandomAdjoiningVoxel(moleculeC, moleculeC);
-              if(moleculeD == NULL)
-                {
-                  return false;
-                }
-              moleculeA->id = A->getVacantID();
-            }
-          D->addMolecule(moleculeD);
+          theReactMethod = &DiffusionInfluencedReactionProcess::reactCAtB;
+        }
+      else if(isSameComp(A, D))
+        {
+          theReactMethod = &DiffusionInfluencedReactionProcess::reactCAtBDAtA;
         }
       else
         {
-          //Hard remove the A molecule since it is not used:
-          moleculeA->id = A->getVacantID();
+          theReactMethod = &DiffusionInfluencedReactionProcess::
+            reactCAtBAdjoiningD;
         }
     }
+  else if(D)
+    {
+      theReactMethod = &DiffusionInfluencedReactionProcess::
+        reactAdjoiningCAndD;
+    }
   else
     {
-      moleculeC = C->getRandomAdjoiningVoxel(moleculeA);
-      if(moleculeC == NULL)
+      theReactMethod = &DiffusionInfluencedReactionProcess::reactAdjoiningC;
+    }
+}
+
+//We need to consider that the source molecule can be either A or B.
+bool DiffusionInfluencedReactionProcess::react(Voxel* moleculeA,
+                                               Voxel* moleculeB)
+{
+  //First let us make sure moleculeA and moleculeB belong to the
+  //correct species.
+  if(theSpatiocyteStepper->getID(moleculeA) != A->getID())
+    {
+      return (this->*theReactMethod)(moleculeB, moleculeA);
+    }
+  return (this->*theReactMethod)(moleculeA, moleculeB);
+}
+
+//nonHD_A + nonHD_B -> nonHD_C + HD_D:
+//nonHD_A + nonHD_B -> HD_C + nonHD_D:
+bool DiffusionInfluencedReactionProcess::reactHDAndNonHDAtA(Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  //Hard remove the B molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
+  theHDProduct->addValue(1);
+  theNonHDProduct->addMolecule(moleculeA);
+  return true;
+}
+
+bool DiffusionInfluencedReactionProcess::reactHDAndNonHDAtB(Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  //Hard remove the A molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+  theHDProduct->addValue(1);
+  theNonHDProduct->addMolecule(moleculeB);
+  return true;
+}
+
+bool DiffusionInfluencedReactionProcess::reactHDAndAdjoiningNonHD(
+                                                            Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  Voxel* moleculeP(theNonHDProduct->getRandomAdjoiningVoxel(moleculeA));
+  //Only proceed if we can find an adjoining vacant voxel
+  //of A which can be occupied by C:
+  if(moleculeP == NULL)
+    {
+      moleculeP = theNonHDProduct->getRandomAdjoiningVoxel(moleculeB);
+      if(moleculeP == NULL)
         {
-          moleculeC = C->getRandomAdjoiningVoxel(moleculeB);
-          if(moleculeC == NULL)
-            {
-              //Only proceed if we can find an adjoining vacant voxel
-              //of A or B which can be occupied by C:
-              return false;
-            }
+          return false;
         }
-      if(D)
+    }
+  //Hard remove the A molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+  //Hard remove the B molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
+  theHDProduct->addValue(1);
+  theNonHDProduct->addMolecule(moleculeP);
+  return true;
+}
+
+//nonHD_A + nonHD_B -> HD_C:
+bool DiffusionInfluencedReactionProcess::reactHD(Voxel* moleculeA,
+                                                 Voxel* moleculeB)
+{
+  //Hard remove the A molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+  //Hard remove the B molecule, since nonHD_p is in a different Comp:
+  theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
+  variableC->addValue(1);
+  return true;
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtA(Voxel* moleculeA,
+                                                   Voxel* moleculeB)
+{
+  return reactCAt(moleculeA, moleculeB, B);
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtB(Voxel* moleculeA,
+                                                   Voxel* moleculeB)
+{
+  return reactCAt(moleculeB, moleculeA, A);
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtADAtB(Voxel* moleculeA,
+                                                       Voxel* moleculeB)
+{
+  return reactCAtDAt(moleculeA, moleculeB);
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtBDAtA(Voxel* moleculeA,
+                                                       Voxel* moleculeB)
+{
+  return reactCAtDAt(moleculeB, moleculeA);
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtAAdjoiningD(
+                                                            Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  return reactCAtAdjoiningD(moleculeA, moleculeB, B);
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtBAdjoiningD(
+                                                            Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  return reactCAtAdjoiningD(moleculeB, moleculeA, A);
+}
+
+//C takes the voxel of moleculeC, and the other reactant, aSpecies at
+//moleculeR, is not used:
+bool DiffusionInfluencedReactionProcess::reactCAt(Voxel* moleculeC,
+                                                  Voxel* moleculeR,
+                                                  Species* aSpecies)
+{
+  //Hard remove the other reactant molecule since it is not used:
+  theSpatiocyteStepper->setID(moleculeR, aSpecies->getVacantID());
+  C->addMolecule(moleculeC);
+  return true;
+}
+
+bool DiffusionInfluencedReactionProcess::reactCAtDAt(Voxel* moleculeC,
+                                                     Voxel* moleculeD)
+{
+  D->addMolecule(moleculeD);
+  C->addMolecule(moleculeC);
+  return true;
+}
+
+//C takes the voxel of moleculeC, while D is placed in a vacant voxel
+//adjoining it, since the other reactant, aSpecies at moleculeR, is in a
+//different Comp:
+bool DiffusionInfluencedReactionProcess::reactCAtAdjoiningD(Voxel* moleculeC,
+                                                            Voxel* moleculeR,
+                                                            Species* aSpecies)
+{
+  Voxel* moleculeD(D->getRandomAdjoiningVoxel(moleculeC, moleculeC));
+  if(moleculeD == NULL)
+    {
+      return false;
+    }
+  theSpatiocyteStepper->setID(moleculeR, aSpecies->getVacantID());
+  D->addMolecule(moleculeD);
+  C->addMolecule(moleculeC);
+  return true;
+}
+
+bool DiffusionInfluencedReactionProcess::reactAdjoiningC(Voxel* moleculeA,
+                                                         Voxel* moleculeB)
+{
+  Voxel* moleculeC(C->getRandomAdjoiningVoxel(moleculeA));
+  if(moleculeC == NULL)
+    {
+      moleculeC = C->getRandomAdjoiningVoxel(moleculeB);
+      if(moleculeC == NULL)
         {
-          moleculeD = D->getRandomAdjoiningVoxel(moleculeC, moleculeC);
-          if(moleculeD == NULL)
-            {
-              return false;
-            }
-          D->addMolecule(moleculeD);
+          //Only proceed if we can find an adjoining vacant voxel
+          //of A or B which can be occupied by C:
+          return false;
         }
-      //Hard remove the A molecule since it is not used:
-      moleculeA->id = A->getVacantID();
-      //Hard remove the B molecule since it is not used:
-      moleculeB->id = B->getVacantID();
     }
+  //Hard remove the A molecule since it is not used:
+  theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+  //Hard remove the B molecule since it is not used:
+  theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
   C->addMolecule(moleculeC);
   return true;
 }
 
-
-  
+bool DiffusionInfluencedReactionProcess::reactAdjoiningCAndD(
+                                                            Voxel* moleculeA,
+                                                            Voxel* moleculeB)
+{
+  Voxel* moleculeC(C->getRandomAdjoiningVoxel(moleculeA));
+  if(moleculeC == NULL)
+    {
+      moleculeC = C->getRandomAdjoiningVoxel(moleculeB);
+      if(moleculeC == NULL)
+        {
+          //Only proceed if we can find an adjoining vacant voxel
+          //of A or B which can be occupied by C:
+          return false;
+        }
+    }
+  Voxel* moleculeD(D->getRandomAdjoiningVoxel(moleculeC, moleculeC));
+  if(moleculeD == NULL)
+    {
+      return false;
+    }
+  D->addMolecule(moleculeD);
+  //Hard remove the A molecule since it is not used:
+  theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+  //Hard remove the B molecule since it is not used:
+  theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
+  C->addMolecule(moleculeC);
+  return true;
+}
 
 void DiffusionInfluencedReactionProcess::finalizeReaction()
 {
   //The number of molecules may have changed for both reactant and product
   //species. We need to update SpatiocyteNextReactionProcesses which are
-  //dependent on these species:
-  for(std::vector<ReactionProcess*>::const_iterator 
-      i(theInterruptingProcesses.begin());
-      i!=theInterruptingProcesses.end(); ++i)
-    {
-      (*i)->substrateValueChanged(theSpatiocyteStepper->getCurrentTime());
-    }
+  //dependent on these species. They are notified by the stepper once the
+  //reactions of the current walk have all been finalized:
+  addInterrupts();
 }
 
 void DiffusionInfluencedReactionProcess::calculateReactionProbability()
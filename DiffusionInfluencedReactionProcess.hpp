@@ -37,12 +37,17 @@
 
 LIBECS_DM_CLASS_EXTRA_1(DiffusionInfluencedReactionProcess, ReactionProcess, virtual DiffusionInfluencedReactionProcessInterface)
 { 
+  typedef bool (DiffusionInfluencedReactionProcess::*ReactMethod)(Voxel*,
+                                                                  Voxel*);
 public:
   LIBECS_DM_OBJECT(DiffusionInfluencedReactionProcess, Process)
     {
       INHERIT_PROPERTIES(ReactionProcess);
     }
-  DiffusionInfluencedReactionProcess() {}
+  DiffusionInfluencedReactionProcess():
+    theNonHDProduct(NULL),
+    theHDProduct(NULL),
+    theReactMethod(&DiffusionInfluencedReactionProcess::reactAdjoiningC) {}
   virtual ~DiffusionInfluencedReactionProcess() {}
   virtual void addSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule) {}
   virtual void removeSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule) {}
@@ -69,11 +74,34 @@ public:
   virtual void finalizeReaction();
 protected:
   void calculateReactionProbability();
+  void setReactMethod();
+  bool isSameComp(Species*, Species*);
+  bool reactHDAndNonHDAtA(Voxel*, Voxel*);
+  bool reactHDAndNonHDAtB(Voxel*, Voxel*);
+  bool reactHDAndAdjoiningNonHD(Voxel*, Voxel*);
+  bool reactHD(Voxel*, Voxel*);
+  bool reactCAtA(Voxel*, Voxel*);
+  bool reactCAtB(Voxel*, Voxel*);
+  bool reactCAtADAtB(Voxel*, Voxel*);
+  bool reactCAtBDAtA(Voxel*, Voxel*);
+  bool reactCAtAAdjoiningD(Voxel*, Voxel*);
+  bool reactCAtBAdjoiningD(Voxel*, Voxel*);
+  bool reactAdjoiningC(Voxel*, Voxel*);
+  bool reactAdjoiningCAndD(Voxel*, Voxel*);
+  bool reactCAt(Voxel*, Voxel*, Species*);
+  bool reactCAtDAt(Voxel*, Voxel*);
+  bool reactCAtAdjoiningD(Voxel*, Voxel*, Species*);
 protected:
   double D_A;
   double D_B;
   double r_v;
   double V;
+  //The products of a reaction with one HD and one nonHD product:
+  Species* theNonHDProduct;
+  Variable* theHDProduct;
+  //The handler of the reaction shape, i.e., the HD and nonHD products and
+  //their Comps, which is resolved once in initializeThird:
+  ReactMethod theReactMethod;
 };
 
 #endif /* __DiffusionInfluencedReactionProcess_hpp */
@@ -36,8 +36,10 @@
 #include <MethodProxy.hpp>
 #include "SpatiocyteProcess.hpp"
 #include "SpatiocyteSpecies.hpp"
+#include "DiffusionGroup.hpp"
+#include "DiffusionProcessInterface.hpp"
 
-LIBECS_DM_CLASS(DiffusionProcess, SpatiocyteProcess)
+LIBECS_DM_CLASS_EXTRA_1(DiffusionProcess, SpatiocyteProcess, DiffusionProcessInterface)
 { 
   typedef void (DiffusionProcess::*WalkMethod)(void) const;
 public:
@@ -54,6 +56,7 @@ public:
     WalkProbability(1),
     theDiffusionSpecies(NULL),
     theVacantSpecies(NULL),
+    theDiffusionGroup(NULL),
     theWalkMethod(&DiffusionProcess::walk) {}
   virtual ~DiffusionProcess() {}
   SIMPLE_SET_GET_METHOD(Real, D);
@@ -183,9 +186,29 @@ public:
     {
       theDiffusionSpecies->addInterruptedProcess(this);
     }
+  virtual void setDiffusionGroup(DiffusionGroup* aDiffusionGroup)
+    {
+      theDiffusionGroup = aDiffusionGroup;
+    }
+  //The species diffused on a vacant species is walked differently, so it
+  //is never part of a DiffusionGroup:
+  virtual bool getIsGroupable()
+    {
+      return theDiffusionSpecies->getDiffusionInterval() != libecs::INF &&
+        theWalkMethod == &DiffusionProcess::walk;
+    }
+  virtual Species* getDiffusionSpecies()
+    {
+      return theDiffusionSpecies;
+    }
   virtual void addSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule)
     {
-      if(theStepInterval == libecs::INF)
+      if(theDiffusionGroup)
+        {
+          theDiffusionGroup->addMolecules(
+                             theSpatiocyteStepper->getCurrentTime());
+        }
+      else if(theStepInterval == libecs::INF)
         {
           theStepInterval = theDiffusionSpecies->getDiffusionInterval();
           theTime = theSpatiocyteStepper->getCurrentTime() + theStepInterval; 
@@ -194,7 +217,14 @@ public:
     }
   virtual void removeSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule)
     {
-      if(theStepInterval != libecs::INF)
+      if(theDiffusionGroup)
+        {
+          if(!theDiffusionSpecies->size())
+            {
+              theDiffusionGroup->removeMolecules();
+            }
+        }
+      else if(theStepInterval != libecs::INF)
         {
           if(theDiffusionSpecies->size())
             {
@@ -211,6 +241,7 @@ protected:
   double WalkProbability;
   Species* theDiffusionSpecies;
   Species* theVacantSpecies;
+  DiffusionGroup* theDiffusionGroup;
   WalkMethod theWalkMethod;
 };
 
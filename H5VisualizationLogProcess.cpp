@@ -377,7 +377,7 @@ void H5VisualizationLogProcess::logMolecules(H5::DataSpace const& space, H5::Dat
     for(int i(0); i != aSize; ++i)
     {
         Voxel* const voxel(aSpecies->getMolecule(i));
-        BOOST_ASSERT(voxel->id == aSpecies->getID());
+        BOOST_ASSERT(theSpatiocyteStepper->getID(voxel) == aSpecies->getID());
         p = pack<ParticleDataPacker>(p, ParticleData(voxel->coord, aSpecies->getID(), aSpecies->getComp()->vacantID));
     }
     dataSet.write(buf.get(), particleDataType, mem, slab);
@@ -95,6 +95,17 @@ public:
       theLogCnt = 0;
       thePriority = -10;
     }
+  //The molecules have been populated by now:
+  virtual void initializeThird()
+    {
+      if(Displacement || Diffusion)
+        {
+          for(unsigned int i(0); i != theProcessSpecies.size(); ++i)
+            {
+              theProcessSpecies[i]->initDisplacements();
+            }
+        }
+    }
   virtual void initializeFourth()
     {
       for(std::vector<Species*>::const_iterator i(theProcessSpecies.begin());
@@ -45,7 +45,8 @@ void MicroscopyTrackingProcess::incSpeciesLatticeCount()
             aMolecule->coord-theStartCoord];
           for(unsigned int k(1); k != theProcessSpeciesIndices[i].size(); ++k)
             {
-              Voxel* anAdjoin(aMolecule->adjoiningVoxels[k-1]);
+              Voxel* anAdjoin(
+                theSpatiocyteStepper->getAdjoiningVoxel(aMolecule, k-1));
               ++theLattice[theProcessSpeciesIndices[i][k]][
                 anAdjoin->coord-theStartCoord];
             }
@@ -92,6 +92,9 @@ void MoleculePopulateProcess::populateUniformOnDiffuseVacant(Species* aSpecies)
               Voxel* aMolecule(aVacantSpecies->getRandomMolecule());
               aVacantSpecies->softRemoveMolecule(aMolecule);
               aSpecies->addMolecule(aMolecule);
+              //addMolecule has removed aMolecule from the tracked molecule
+              //list of aVacantSpecies:
+              aVacantSpecies->updateDiffuseVacantMolecules();
             }
         }
       else
@@ -122,7 +125,7 @@ void MoleculePopulateProcess::populateUniformDense(Species* aSpecies,
                   aVoxel = theSpatiocyteStepper->coord2voxel(
                     aComp->coords[aList[(*aCount)++]]);
                 }
-              while(aVoxel->id != aComp->vacantID);
+              while(theSpatiocyteStepper->getID(aVoxel) != aComp->vacantID);
               aSpecies->addMolecule(aVoxel);
             }
         }
@@ -143,18 +146,24 @@ void MoleculePopulateProcess::populateUniformSparse(Species* aSpecies)
          !OriginX && !OriginY && !OriginZ)
         {
           unsigned int aSize(aSpecies->getPopulateMoleculeSize());
-          int availableVoxelSize(aComp->coords.size());
+          //The vacant voxels shrink as the molecules are added:
+          std::vector<Voxel*>& aVacantVoxels(aComp->vacantVoxels);
+          if(aVacantVoxels.size() < aSize)
+            {
+              THROW_EXCEPTION(ValueError, String(
+                              getPropertyInterface().getClassName()) +
+                              "[" + getFullID().asString() + "]: There are " +
+                              int2str(aSize) + " " + getIDString(aSpecies) +
+                              " molecules that must be uniformly populated," +
+                              "\nbut there are only " +
+                              int2str(aVacantVoxels.size()) + 
+                              " vacant voxels in " + getIDString(aComp) +
+                              " that can be populated on.");
+            }
           for(unsigned int j(0); j != aSize; ++j)
             {
-              Voxel* aVoxel;
-              do
-                {
-                  aVoxel = theSpatiocyteStepper->coord2voxel(
-                     aComp->coords[gsl_rng_uniform_int(
-                                getStepper()->getRng(), availableVoxelSize)]);
-                }
-              while(aVoxel->id != aComp->vacantID);
-              aSpecies->addMolecule(aVoxel);
+              aSpecies->addMolecule(aVacantVoxels[gsl_rng_uniform_int(
+                  getStepper()->getRng(), aVacantVoxels.size())]);
             }
         }
       else
@@ -193,7 +202,7 @@ void MoleculePopulateProcess::populateUniformRanged(Species* aSpecies)
     {
       Voxel* aVoxel(theSpatiocyteStepper->coord2voxel(*i));
       Point aPoint(theSpatiocyteStepper->coord2point(aVoxel->coord));
-      if(aVoxel->id == aSpecies->getVacantID() &&
+      if(theSpatiocyteStepper->getID(aVoxel) == aSpecies->getVacantID() &&
          aPoint.x < maxX && aPoint.x > minX &&
          aPoint.y < maxY && aPoint.y > minY &&
          aPoint.z < maxZ && aPoint.z > minZ)
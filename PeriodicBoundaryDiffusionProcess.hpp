@@ -58,9 +58,16 @@ public:
       for(std::vector<Species*>::const_iterator i(theProcessSpecies.begin());
           i != theProcessSpecies.end(); ++i)
         {
-          (*i)->initMoleculeOrigins();
+          (*i)->initDisplacements();
+          (*i)->initBoundaryMolecules();
         }
     }
+  //The molecules must be relocated after every walk, which a fused
+  //DiffusionGroup walk would skip:
+  virtual bool getIsGroupable()
+    {
+      return false;
+    }
   virtual void fire()
     {
       DiffusionProcess::fire();
@@ -186,7 +186,8 @@ void PolymerFragmentationProcess::addSubstrateInterrupt(Species* aSpecies,
       Subunit* subunitA(aMolecule->subunit);
       if(subunitA->targetVoxels.size() &&
          subunitA->targetVoxels[theBendIndexA] &&
-         subunitA->targetVoxels[theBendIndexA]->id == B->getID())
+         theSpatiocyteStepper->getID(subunitA->targetVoxels[theBendIndexA]) ==
+         B->getID())
         { 
           addMoleculeA(aMolecule);
           return;
@@ -197,7 +198,8 @@ void PolymerFragmentationProcess::addSubstrateInterrupt(Species* aSpecies,
       Subunit* subunitB(aMolecule->subunit);
       if(subunitB->sourceVoxels.size() &&
          subunitB->sourceVoxels[theBendIndexB] &&
-         subunitB->sourceVoxels[theBendIndexB]->id == A->getID())
+         theSpatiocyteStepper->getID(subunitB->sourceVoxels[theBendIndexB]) ==
+         A->getID())
         { 
           addMoleculeA(subunitB->sourceVoxels[theBendIndexB]);
           return;
@@ -225,7 +227,7 @@ void PolymerFragmentationProcess::removeSubstrateInterrupt(Species* aSpecies,
       Subunit* subunitB(aMolecule->subunit);
       Voxel* moleculeA(subunitB->sourceVoxels[theBendIndexB]);
       if(subunitB->sourceVoxels.size() && moleculeA &&
-         moleculeA->id == A->getID())
+         theSpatiocyteStepper->getID(moleculeA) == A->getID())
         { 
           for(unsigned int i(0); i < theReactantSize; ++i)
             {
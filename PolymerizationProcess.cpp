@@ -261,6 +261,7 @@ void PolymerizationProcess::pinStep(double* currX, double *fixedDcm,
 
 void PolymerizationProcess::initializeThird()
 {
+  DiffusionInfluencedReactionProcess::initializeThird();
   theMinX = C->getWestPoint().x;
   theMaxX = C->getEastPoint().x;
   theOriY = C->getWestPoint().y;
@@ -337,16 +338,27 @@ void PolymerizationProcess::finalizeReaction()
   DiffusionInfluencedReactionProcess::finalizeReaction();
 }
 
-bool PolymerizationProcess::isInterrupting(Process* aProcess)
+//The fragmentation processes need not share a variable with this process,
+//so they are linked from the full process list instead of aProcessList,
+//which only holds the processes sharing a variable with this process:
+void PolymerizationProcess::setInterrupt(
+                                   std::vector<Process*> const& aProcessList,
+                                   Process* aProcess)
 {
-  if(aProcess->getPropertyInterface().getClassName() ==
-     "PolymerFragmentationProcess") 
+  Stepper::ProcessVector const& aProcesses(
+                                 theSpatiocyteStepper->getProcessVector());
+  for(Stepper::ProcessVector::const_iterator i(aProcesses.begin());
+      i != aProcesses.end(); ++i)
     {
-      PolymerFragmentationProcess* aDepolymerizeProcess(
-           dynamic_cast<PolymerFragmentationProcess*>(aProcess));
-      aDepolymerizeProcess->setPolymerizeProcess(this);
+      if((*i)->getPropertyInterface().getClassName() ==
+         "PolymerFragmentationProcess") 
+        {
+          PolymerFragmentationProcess* aDepolymerizeProcess(
+               dynamic_cast<PolymerFragmentationProcess*>(*i));
+          aDepolymerizeProcess->setPolymerizeProcess(this);
+        }
     }
-  return ReactionProcess::isInterrupting(aProcess);
+  ReactionProcess::setInterrupt(aProcessList, aProcess);
 }
 
 void PolymerizationProcess::initJoinSubunit(Voxel* aMolecule, Species* aSpecies,
@@ -531,8 +543,9 @@ void PolymerizationProcess::removeLipid(Subunit* aSubunit,
         aSubunit->sharedLipids[aBendIndex];
       removeContPoint(aSubunit->sharedLipids[aBendIndex]->subunit,
                       &aSubunit->subunitPoint);
-      aSubunit->sharedLipids[aBendIndex]->id = 
-        id2species(aSubunit->sharedLipids[aBendIndex]->id)->getVacantID(); 
+      Voxel* aLipid(aSubunit->sharedLipids[aBendIndex]);
+      theSpatiocyteStepper->setID(aLipid, id2species(
+          theSpatiocyteStepper->getID(aLipid))->getVacantID()); 
       aSubunit->sharedLipids[aBendIndex] = NULL;
     }
 }
@@ -555,7 +568,7 @@ bool PolymerizationProcess::react(Voxel* moleculeB, Voxel** target)
   //calling Species.
   //First let us make sure moleculeA and moleculeB belong to the
   //correct species.
-  if(moleculeA->id != A->getID())
+  if(theSpatiocyteStepper->getID(moleculeA) != A->getID())
     {
       Voxel* tempA(moleculeA);
       moleculeA = moleculeB;
@@ -572,9 +585,10 @@ bool PolymerizationProcess::react(Voxel* moleculeB, Voxel** target)
           Voxel* moleculeD(getTargetVoxel(subunitA));
           if(moleculeD != NULL &&
              (moleculeD == moleculeB || 
-              theSpatiocyteStepper->id2species(moleculeD->id)->getIsLipid()))
+              theSpatiocyteStepper->id2species(
+                             theSpatiocyteStepper->getID(moleculeD))->getIsLipid()))
             { 
-              moleculeB->id = B->getVacantID();
+              theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
               initJoinSubunit(moleculeD, D, subunitA); 
               moleculeD->subunit->sourceVoxels[theBendIndexB] = moleculeA;
               C->addMolecule(moleculeA);
@@ -602,9 +616,9 @@ bool PolymerizationProcess::react(Voxel* moleculeB, Voxel** target)
             }
           if(moleculeD != NULL &&
              (moleculeD == moleculeB || theSpatiocyteStepper->id2species(
-                             moleculeD->id)->getIsLipid()))
+                             theSpatiocyteStepper->getID(moleculeD))->getIsLipid()))
             { 
-              moleculeB->id = B->getVacantID();
+              theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
               initJoinSubunit(moleculeD, D, subunitA); 
               moleculeD->subunit->sourceVoxels[theBendIndexB] = moleculeA;
               C->addMolecule(moleculeA);
@@ -647,8 +661,8 @@ bool PolymerizationProcess::react(Voxel* moleculeB, Voxel** target)
             {
               moleculeC = moleculeA;
             }
-          moleculeA->id = A->getVacantID();
-          moleculeB->id = B->getVacantID();
+          theSpatiocyteStepper->setID(moleculeA, A->getVacantID());
+          theSpatiocyteStepper->setID(moleculeB, B->getVacantID());
           C->addMolecule(moleculeC);
           resetSubunit(moleculeA->subunit);
           finalizeReaction(); 
@@ -666,7 +680,8 @@ void PolymerizationProcess::updateSharedLipidsID(Voxel* aMolecule)
     {
       if(sharedLipids[i])
         {
-          sharedLipids[i]->id = aMolecule->id;
+          theSpatiocyteStepper->setID(sharedLipids[i],
+                                      theSpatiocyteStepper->getID(aMolecule));
         }
     }
 }
@@ -709,10 +724,12 @@ double PolymerizationProcess::setImmediateTargetVoxel(Subunit* aRefSubunit,
   Voxel* aRefVoxel(aRefSubunit->voxel);
   Point* aRefPoint(&aRefSubunit->targetPoints[aBendIndex]);
   double anImmediateDist(LARGE_DISTANCE);
-  std::vector<Voxel*>& immediateSurface((*aRefVoxel->surfaceVoxels)[IMMEDIATE]);
+  unsigned int immediateSize;
+  Voxel** immediateSurface(theSpatiocyteStepper->getSurfaceVoxels(
+                             aRefVoxel, IMMEDIATE, immediateSize));
   //Check the immediate 6 (usually) surface voxels adjoining the voxel of the
   //reference subunit:
-  for(unsigned int i(0); i!=immediateSurface.size(); ++i)
+  for(unsigned int i(0); i!=immediateSize; ++i)
     {
       Voxel* aVoxel(immediateSurface[i]);
       Subunit* aSubunit(aVoxel->subunit);
@@ -749,11 +766,13 @@ bool PolymerizationProcess::setExtendedTargetVoxel(Subunit* aRefSubunit,
 {
   Voxel* aRefVoxel(aRefSubunit->voxel);
   Point* aRefPoint(&aRefSubunit->targetPoints[aBendIndex]);
-  std::vector<Voxel*>& extendedSurface((*aRefVoxel->surfaceVoxels)[EXTENDED]);
+  unsigned int extendedSize;
+  Voxel** extendedSurface(theSpatiocyteStepper->getSurfaceVoxels(
+                            aRefVoxel, EXTENDED, extendedSize));
   int extIndex(-1);
   //Check the immediate surface voxels adjoining the immediate surface voxels
   //of the reference subunit, defined as the extended surface voxels:
-  for(unsigned int i(0); i != extendedSurface.size(); ++i)
+  for(unsigned int i(0); i != extendedSize; ++i)
     { 
       Voxel* aVoxel(extendedSurface[i]);
       Subunit* aSubunit(aVoxel->subunit);
@@ -767,12 +786,13 @@ bool PolymerizationProcess::setExtendedTargetVoxel(Subunit* aRefSubunit,
             { 
               //Find the shared voxel which connects the reference voxel
               //to the extended voxel:
-              std::vector<Voxel*>& 
-                aSharedList((*aRefVoxel->surfaceVoxels)[SHARED+i]);
+              unsigned int aSharedSize;
+              Voxel** aSharedList(theSpatiocyteStepper->getSharedVoxels(
+                                    aRefVoxel, i, aSharedSize));
               //Check if there is an existing shared voxel or a voxel
               //that is unoccupied by a protomer, which connects
               //the reference voxel to the extended voxel:
-              for(unsigned int j(0); j!=aSharedList.size(); ++j)
+              for(unsigned int j(0); j!=aSharedSize; ++j)
                 { 
                   Voxel* aSharedVoxel(aSharedList[j]);
                   if(aSharedVoxel->subunit->contPoints.empty() ||
@@ -794,11 +814,12 @@ bool PolymerizationProcess::setExtendedTargetVoxel(Subunit* aRefSubunit,
       if(extIndex != -1)
         {
           Voxel* aVoxel(extendedSurface[extIndex]);
-          std::vector<Voxel*>& 
-            aSharedList((*aRefVoxel->surfaceVoxels)[SHARED+extIndex]);
+          unsigned int aSharedSize;
+          Voxel** aSharedList(theSpatiocyteStepper->getSharedVoxels(
+                                aRefVoxel, extIndex, aSharedSize));
           double aSharedDist(LARGE_DISTANCE);
           Voxel* aSelectedSharedVoxel;
-          for(unsigned int i(0); i!=aSharedList.size(); ++i)
+          for(unsigned int i(0); i!=aSharedSize; ++i)
             { 
               Voxel* aSharedVoxel(aSharedList[i]);
               Subunit* aSubunit(aVoxel->subunit);
@@ -822,8 +843,8 @@ bool PolymerizationProcess::setExtendedTargetVoxel(Subunit* aRefSubunit,
             }
           //If the selected shared voxel is not an existing shared voxel nor
           //a lipid:
-          if(!theSpatiocyteStepper->id2species(
-                            aSelectedSharedVoxel->id)->getIsLipid() &&
+          if(!theSpatiocyteStepper->id2species(theSpatiocyteStepper->getID(
+                            aSelectedSharedVoxel))->getIsLipid() &&
              aSelectedSharedVoxel->subunit->voxel != aRefVoxel)
             {
               return false;
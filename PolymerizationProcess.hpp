@@ -61,7 +61,7 @@ public:
     }
   virtual void initializeThird();
   virtual bool react(Voxel*, Voxel**);
-  virtual bool isInterrupting(Process*);
+  virtual void setInterrupt(std::vector<Process*> const&, Process*);
   virtual void finalizeReaction();
   void resetSubunit(Subunit*);
   void removeContPoint(Subunit*,  Point*);
@@ -33,10 +33,15 @@
 #ifndef __PriorityQueue_hpp
 #define __PriorityQueue_hpp
 
+#include <algorithm>
 #include <DynamicPriorityQueue.hpp>
 
 USE_LIBECS;
 
+//The queue is a d-ary heap. A binary heap (arity 2) is used by default,
+//while a 4-ary heap is shallower and its children share a cache line,
+//which is faster with thousands of reaction processes. The arity must be a
+//power of two so that the parent and children are found by shifting:
 template<typename Item, class IDPolicy = VolatileIDPolicy>
 class PriorityQueue
 {
@@ -50,7 +55,25 @@ public:
   void clear(); 
   inline ID push(const Item& item); 
   inline void movePos(Index pos); 
-  PriorityQueue() {}
+  PriorityQueue():
+    arityShift(1) {}
+  //Only allowed when the queue is empty:
+  bool setArity(unsigned int anArity)
+    {
+      for(unsigned int i(1); i != 4; ++i)
+        {
+          if(anArity == (1U << i))
+            {
+              arityShift = i;
+              return true;
+            }
+        }
+      return false;
+    }
+  unsigned int getArity() const
+    {
+      return 1U << arityShift;
+    }
   bool isEmpty() const
     {
       return this->itemVector.empty();
@@ -133,7 +156,39 @@ public:
 private:
   inline void moveUpPos(Index position, Index start = 0);
   inline void moveDownPos(Index position); 
+  //An item with an earlier time, or with a higher priority at the same
+  //time, is executed first:
+  bool isBefore(const Item& anItem, const Item& aPivot) const
+    {
+      return anItem->getTime() < aPivot->getTime() ||
+        (anItem->getTime() == aPivot->getTime() &&
+         anItem->getQueuePriority() > aPivot->getQueuePriority());
+    }
+  Index getParentPos(Index pos) const
+    {
+      return (pos-1) >> arityShift;
+    }
+  Index getChildPos(Index pos) const
+    {
+      return (pos << arityShift)+1;
+    }
+  //Returns the position of the earliest of the children starting at succ:
+  Index getEarliestChildPos(Index succ, Index size) const
+    {
+      const Index end(std::min(succ+(1 << arityShift), size));
+      Index earliest(succ);
+      for(Index i(succ+1); i < end; ++i)
+        {
+          if(isBefore(this->itemVector[this->heap[i]],
+                      this->itemVector[this->heap[earliest]]))
+            {
+              earliest = i;
+            }
+        }
+      return earliest;
+    }
 private:
+  unsigned int arityShift;
   ItemVector itemVector;
   IndexVector heap; 
   IndexVector positionVector;
@@ -155,35 +210,18 @@ void PriorityQueue<Item, IDPolicy>::movePos(Index pos)
   const Index index(this->heap[pos]);
   const Item& item(this->itemVector[index]); 
   const Index size(getSize()); 
-  if(pos < size/2)
+  const Index succ(getChildPos(pos));
+  if(succ < size && isBefore(this->itemVector[this->heap[
+                               getEarliestChildPos(succ, size)]], item))
     {
-      const Index succ(2*pos+1);
-      if(this->itemVector[this->heap[succ]]->getTime() < item->getTime() ||
-         (this->itemVector[this->heap[succ]]->getTime() == item->getTime() &&
-          this->itemVector[this->heap[succ]]->getQueuePriority() >
-          item->getQueuePriority()) ||
-         (succ+1 < size &&
-          this->itemVector[this->heap[succ+1]]->getTime() < item->getTime()) ||
-         (succ+1 < size &&
-          this->itemVector[this->heap[succ+1]]->getTime() == item->getTime() &&
-          this->itemVector[this->heap[succ+1]]->getQueuePriority() >
-          item->getQueuePriority()))
-        {
-          moveDownPos(pos);
-          return;
-        }
+      moveDownPos(pos);
+      return;
     } 
-  if(pos > 0)
+  if(pos > 0 && isBefore(item, this->itemVector[this->heap[
+                                getParentPos(pos)]]))
     {
-      const Index pred((pos-1)/2);
-      if(item->getTime() < this->itemVector[this->heap[pred]]->getTime() ||
-         (item->getTime() == this->itemVector[this->heap[pred]]->getTime() &&
-          item->getQueuePriority() >
-          this->itemVector[this->heap[pred]]->getQueuePriority()))
-        {
-          moveUpPos(pos);
-          return;
-        }
+      moveUpPos(pos);
+      return;
     }
 }
 
@@ -200,11 +238,9 @@ void PriorityQueue<Item, IDPolicy>::moveUpPos(Index position,
   Index pos(position);
   while(pos > start)
     {
-      const Index pred((pos-1)/2);
+      const Index pred(getParentPos(pos));
       const Index predIndex(this->heap[pred]);
-      if(this->itemVector[predIndex]->getTime() < item->getTime() ||
-         (this->itemVector[predIndex]->getTime() == item->getTime() &&
-          this->itemVector[predIndex]->getQueuePriority() > item->getQueuePriority()))
+      if(isBefore(this->itemVector[predIndex], item))
         {
           break;
         } 
@@ -216,30 +252,22 @@ void PriorityQueue<Item, IDPolicy>::moveUpPos(Index position,
   this->positionVector[index] = pos;
 }
 
+//The item is first moved down to a leaf along the earliest children and
+//then moved back up, which needs fewer comparisons than a top-down sift:
 template<typename Item, class IDPolicy>
 void PriorityQueue<Item, IDPolicy>::moveDownPos(Index position)
 {
   const Index index(this->heap[position]);
   const Index size(getSize()); 
-  Index succ(2*position+1);
+  Index succ(getChildPos(position));
   Index pos(position);
   while(succ < size)
     {
-      const Index rightPos(succ + 1);
-      if(rightPos < size &&
-         (this->itemVector[this->heap[rightPos]]->getTime() <
-          this->itemVector[this->heap[succ]]->getTime() ||
-          (this->itemVector[this->heap[rightPos]]->getTime() ==
-           this->itemVector[this->heap[succ]]->getTime() &&
-           this->itemVector[this->heap[rightPos]]->getQueuePriority() >
-           this->itemVector[this->heap[succ]]->getQueuePriority())))
-        {
-          succ = rightPos;
-        } 
+      succ = getEarliestChildPos(succ, size);
       this->heap[pos] = this->heap[succ];
       this->positionVector[this->heap[pos]] = pos;
       pos = succ;
-      succ = 2*pos+1;
+      succ = getChildPos(pos);
     } 
   this->heap[pos] = index;
   this->positionVector[index] = pos; 
@@ -0,0 +1,269 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+
+#ifndef __ReactionGroup_hpp
+#define __ReactionGroup_hpp
+
+#include <climits>
+#include <gsl/gsl_rng.h>
+#include "SpatiocyteCommon.hpp"
+#include "SpatiocyteProcessInterface.hpp"
+#include "SpatiocyteNextReactionProcessInterface.hpp"
+
+//The SpatiocyteNextReactionProcesses of a ReactionGroup share a single entry
+//in the priority queue, and the next reaction is selected with the
+//composition-rejection method (Slepoy et al., J. Chem. Phys., 2008). The
+//reactions are binned by the binary exponent of their propensities so that
+//a reaction in the bin of exponent e has a propensity in [2^(e-1), 2^e).
+//A bin is first selected according to the bin propensity sums, and then a
+//reaction of the bin is accepted with the probability propensity/2^e,
+//which is at least 1/2. When the substrates of a reaction change, only the
+//reaction and its bins are updated.
+class ReactionGroup: public SpatiocyteProcessInterface
+{
+public:
+  ReactionGroup(const gsl_rng* aRng):
+    isFiring(false),
+    theMinExponent(0),
+    thePriority(INT_MIN),
+    theTime(libecs::INF),
+    theTotalPropensity(0),
+    theRng(aRng),
+    thePriorityQueue(NULL) {}
+  virtual ~ReactionGroup() {}
+  virtual void initializeSecond() {}
+  virtual void initializeThird() {}
+  virtual void initializeFourth() {}
+  virtual void initializeLastOnce() {}
+  virtual void printParameters()
+    {
+      std::cout << "ReactionGroup" << std::endl;
+      std::cout << "  reactions:" << theReactions.size() << " bins:" <<
+        theBins.size() << " total propensity:" << theTotalPropensity <<
+        std::endl;
+    }
+  virtual void substrateValueChanged(Time) {}
+  virtual void setPriorityQueue(ProcessPriorityQueue* aPriorityQueue)
+    {
+      thePriorityQueue = aPriorityQueue;
+    }
+  virtual void setTime(Time aTime)
+    {
+      theTime = aTime;
+    }
+  virtual Time getTime() const
+    {
+      return theTime;
+    }
+  //The group is executed with the highest priority of its processes at
+  //the same time:
+  virtual int getQueuePriority() const
+    {
+      return thePriority;
+    }
+  virtual void setQueueID(ProcessID anID)
+    {
+      theQueueID = anID;
+    }
+  virtual void addSubstrateInterrupt(Species*, Voxel*) {}
+  virtual void removeSubstrateInterrupt(Species*, Voxel*) {}
+  bool isEmpty() const
+    {
+      return theReactions.empty();
+    }
+  void addReaction(SpatiocyteNextReactionProcessInterface* aReaction)
+    {
+      aReaction->setReactionGroup(this, theReactions.size());
+      theReactions.push_back(aReaction);
+      thePropensities.push_back(0);
+      theExponents.push_back(0);
+      theBinPositions.push_back(UINT_MAX);
+      addPriority(dynamic_cast<SpatiocyteProcessInterface*>(aReaction));
+    }
+  //Must be called before the group is pushed into the priority queue:
+  void initialize(Time aCurrentTime)
+    {
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          updatePropensity(i);
+        }
+      theTime = aCurrentTime+getStepInterval();
+    }
+  //Called by the reaction when its substrates have changed:
+  void update(unsigned int anIndex, Time aCurrentTime)
+    {
+      updatePropensity(anIndex);
+      //The reactions are Markovian, so we can draw a new time with the
+      //updated total propensity. While firing, the group is requeued once
+      //after all the updates:
+      if(!isFiring)
+        {
+          theTime = aCurrentTime+getStepInterval();
+          thePriorityQueue->move(theQueueID);
+        }
+    }
+  virtual void fire()
+    {
+      const Time aCurrentTime(theTime);
+      const unsigned int anIndex(selectReaction());
+      isFiring = true;
+      theReactions[anIndex]->fireGroup(aCurrentTime);
+      //The fired reaction is not in its own interrupt list:
+      updatePropensity(anIndex);
+      isFiring = false;
+      theTime = aCurrentTime+getStepInterval();
+      thePriorityQueue->moveTop();
+    }
+private:
+  double getStepInterval()
+    {
+      //Recompute the total from the bins to avoid accumulating rounding
+      //errors over the updates:
+      theTotalPropensity = 0;
+      for(unsigned int i(0); i != theBinSums.size(); ++i)
+        {
+          theTotalPropensity += theBinSums[i];
+        }
+      if(theTotalPropensity <= 0)
+        {
+          return libecs::INF;
+        }
+      return -log(gsl_rng_uniform_pos(theRng))/theTotalPropensity;
+    }
+  unsigned int selectReaction()
+    {
+      //Composition: select a bin according to its propensity sum.
+      double aValue(gsl_rng_uniform(theRng)*theTotalPropensity);
+      unsigned int aBin(0);
+      while(aBin+1 < theBins.size() && aValue >= theBinSums[aBin])
+        {
+          aValue -= theBinSums[aBin];
+          ++aBin;
+        }
+      //Skip the empty bins at the end because of the rounding errors:
+      while(theBins[aBin].empty())
+        {
+          --aBin;
+        }
+      //Rejection: the propensities in the bin are < 2^(aBin+theMinExponent):
+      const std::vector<unsigned int>& aReactions(theBins[aBin]);
+      const double aMaxPropensity(ldexp(1.0, aBin+theMinExponent));
+      while(true)
+        {
+          const unsigned int anIndex(aReactions[
+                       gsl_rng_uniform_int(theRng, aReactions.size())]);
+          if(gsl_rng_uniform(theRng)*aMaxPropensity < thePropensities[anIndex])
+            {
+              return anIndex;
+            }
+        }
+    }
+  void updatePropensity(unsigned int anIndex)
+    {
+      const double aPropensity(theReactions[anIndex]->getGroupPropensity());
+      removeFromBin(anIndex);
+      thePropensities[anIndex] = aPropensity;
+      if(aPropensity > 0)
+        {
+          int anExponent;
+          frexp(aPropensity, &anExponent);
+          addToBin(anIndex, anExponent);
+        }
+    }
+  void addToBin(unsigned int anIndex, int anExponent)
+    {
+      if(theBins.empty())
+        {
+          theMinExponent = anExponent;
+        }
+      else if(anExponent < theMinExponent)
+        {
+          const unsigned int aShift(theMinExponent-anExponent);
+          theBins.insert(theBins.begin(), aShift, std::vector<unsigned int>());
+          theBinSums.insert(theBinSums.begin(), aShift, 0.0);
+          theMinExponent = anExponent;
+        }
+      const unsigned int aBin(anExponent-theMinExponent);
+      if(aBin >= theBins.size())
+        {
+          theBins.resize(aBin+1);
+          theBinSums.resize(aBin+1, 0.0);
+        }
+      theExponents[anIndex] = anExponent;
+      theBinPositions[anIndex] = theBins[aBin].size();
+      theBins[aBin].push_back(anIndex);
+      theBinSums[aBin] += thePropensities[anIndex];
+    }
+  void removeFromBin(unsigned int anIndex)
+    {
+      const unsigned int aPosition(theBinPositions[anIndex]);
+      //The reaction is not in any bin if its propensity is zero:
+      if(aPosition == UINT_MAX)
+        {
+          return;
+        }
+      const unsigned int aBin(theExponents[anIndex]-theMinExponent);
+      std::vector<unsigned int>& aReactions(theBins[aBin]);
+      aReactions[aPosition] = aReactions.back();
+      theBinPositions[aReactions[aPosition]] = aPosition;
+      aReactions.pop_back();
+      theBinSums[aBin] -= thePropensities[anIndex];
+      if(aReactions.empty())
+        {
+          theBinSums[aBin] = 0;
+        }
+      theBinPositions[anIndex] = UINT_MAX;
+    }
+  void addPriority(SpatiocyteProcessInterface* aProcess)
+    {
+      if(aProcess && aProcess->getQueuePriority() > thePriority)
+        {
+          thePriority = aProcess->getQueuePriority();
+        }
+    }
+private:
+  bool isFiring;
+  int theMinExponent;
+  int thePriority;
+  Time theTime;
+  double theTotalPropensity;
+  const gsl_rng* theRng;
+  ProcessID theQueueID;
+  ProcessPriorityQueue* thePriorityQueue; 
+  std::vector<SpatiocyteNextReactionProcessInterface*> theReactions;
+  std::vector<double> thePropensities;
+  std::vector<int> theExponents;
+  std::vector<unsigned int> theBinPositions;
+  std::vector<std::vector<unsigned int> > theBins;
+  std::vector<double> theBinSums;
+};
+
+#endif /* __ReactionGroup_hpp */
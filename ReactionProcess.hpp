@@ -49,6 +49,7 @@ public:
     k(-1),
     p(-1),
     theOrder(0),
+    theInterruptStamp(0),
     A(NULL),
     B(NULL),
     C(NULL),
@@ -74,7 +75,7 @@ public:
           (*i)->substrateValueChanged(aCurrentTime);
         }
     }
-  void requeue()
+  virtual void requeue()
     {
       theTime += getStepInterval(); // do this only for the Processes in Q
       thePriorityQueue->moveTop(); // do this only for the Processes in Q
@@ -150,6 +151,22 @@ public:
     {
       return E;
     }
+  //Queue the interrupted processes in the stepper to be notified together
+  //with those of the other reactions in the same walk:
+  void addInterrupts()
+    {
+      const unsigned int aStamp(theSpatiocyteStepper->getInterruptStamp());
+      for(std::vector<ReactionProcess*>::const_iterator 
+          i(theInterruptingProcesses.begin());
+          i!=theInterruptingProcesses.end(); ++i)
+        {
+          if((*i)->theInterruptStamp != aStamp)
+            {
+              (*i)->theInterruptStamp = aStamp;
+              theSpatiocyteStepper->addInterrupt(*i);
+            }
+        }
+    }
   virtual void addSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule) {}
   virtual void removeSubstrateInterrupt(Species* aSpecies, Voxel* aMolecule) {}
 protected:
@@ -158,6 +175,7 @@ protected:
   double k;
   double p;
   int theOrder;
+  unsigned int theInterruptStamp;
   //Species are for non HD species:
   Species* A;
   Species* B;
@@ -40,6 +40,8 @@ class ReactionProcessInterface
 { 
 public:
   virtual ~ReactionProcessInterface() {}
+  //aProcessList holds only the processes that access a variable of
+  //aProcess, as indexed by the stepper:
   virtual void setInterrupt(std::vector<Process*> const &aProcessList, Process* aProcess) = 0;
 };
 
@@ -35,12 +35,18 @@
 #include <iostream>
 #include <iomanip>
 #include <math.h>
+#include <stdint.h>
 #include <libecs.hpp>
 #include <FullID.hpp>
 #include "PriorityQueue.hpp"
 
 class SpatiocyteProcessInterface;
+class DiffusionInfluencedReactionProcessInterface;
 class Species;
+class RandomBuffer;
+class ReactionGroup;
+class TauLeapGroup;
+class DiffusionGroup;
 struct Subunit;
 typedef PriorityQueue<SpatiocyteProcessInterface*> ProcessPriorityQueue;
 typedef ProcessPriorityQueue::ID ProcessID;
@@ -49,6 +55,14 @@ typedef ProcessPriorityQueue::ID ProcessID;
 #define HCP_LATTICE   0
 #define CUBIC_LATTICE 1
 
+//Random number engines of the species:
+#define GSL_RANDOM    0
+#define PHILOX_RANDOM 1
+
+//The number of random variates generated at once by a RandomBuffer with
+//the PHILOX_RANDOM engine:
+#define RANDOM_BUFFER_SIZE 256
+
 //Comp dimensions:
 #define VOLUME  3
 #define SURFACE 2
@@ -88,30 +102,89 @@ typedef ProcessPriorityQueue::ID ProcessID;
 #define DORSAL   4 
 #define VENTRAL  5
 
+//The largest number of adjoining voxels of a voxel in all lattice types:
+#define MAX_ADJOINING_VOXEL_SIZE 12
+
+//The adjoiningVoxels arrays of the lattice are allocated in cubic bricks
+//with this number of voxels along each side. It must be 8 for the three
+//bits per axis of the Morton order:
+#define LATTICE_BRICK_SIZE 8
+
+//The order of the voxels in the lattice:
+#define ROW_MAJOR_ORDER 0
+#define MORTON_ORDER    1
+
+//The version of the lattice file written by SpatiocyteStepper. It must be
+//incremented whenever the layout of the file changes:
+#define LATTICE_FILE_VERSION 2
+#define LATTICE_FILE_MAGIC "SPATIOLT"
+
+//The minimum number of molecules of a species before its walk is split
+//among the threads when the SpatiocyteStepper ThreadSize > 1:
+#define MIN_THREADED_WALK_SIZE 1024
+
+//The minimum number of columns in each sector of a threaded walk: 
+#define MIN_SECTOR_COL_SIZE 4
+
+//The number of molecules in each block of a sorted molecule list of a
+//species. The order of the blocks is shuffled after every sort:
+#define MOLECULE_SORT_BLOCK_SIZE 256
+
+//The tau-leaping of the HD reactions (SpatiocyteStepper TauLeap > 0). A
+//reaction is critical and only fired exactly when any of its reactants
+//would be exhausted within this number of firings:
+#define TAU_LEAP_CRITICAL_SIZE 10
+//Exact SSA steps are taken instead of a leap when the leap is shorter than
+//this number of mean SSA step intervals:
+#define TAU_LEAP_SSA_FACTOR 10
+
+//The periodic boundary flags of a voxel, one for the boundary of volume
+//species and one for the boundary of surface species:
+#define VOLUME_BOUNDARY  1
+#define SURFACE_BOUNDARY 2
+
 #define INNER     0
 #define OUTER     1
 #define IMMEDIATE 2
 #define EXTENDED  3
 #define SHARED    4
 
+//The number of surface voxel list types, INNER to SHARED:
+#define SURFACE_LIST_SIZE 5
+
 //Polymerization parameters
 #define LARGE_DISTANCE 50
 #define MAX_MONOMER_OVERLAP 0.2
 #define MAX_IMMEDIATE_DISTANCE 0.2 
 #define BIG_NUMBER 1e+20
 
+//The species ID of each voxel is not stored here but in the dense
+//SpatiocyteStepper::theIDs array (see SpatiocyteStepper::getID), so that
+//the walk only touches two bytes per probed voxel. Voxel only holds the
+//topology and polymer data, which are rarely accessed during diffusion:
 struct Voxel
 {
-  //We use short here to maintain the size of Voxel as 128 bytes which helps
-  //prefetching. Species ID:
-  unsigned short id;
   //Try to limit the adjoiningSize <= 6:
   unsigned short adjoiningSize;
-  unsigned int coord; //coord = aComp->coords[x] + theStartCoord
+  unsigned int coord; //coord = theStartCoord + row-major index of the voxel
   Voxel** adjoiningVoxels;
   Subunit* subunit;
-  //Contains adjoining and extended surface voxels:
-  std::vector<std::vector<Voxel*> >* surfaceVoxels;
+  //The index of the adjoining and extended surface voxels lists of a surface
+  //voxel in SpatiocyteStepper::theSurfaceVoxels. It is 0, which has empty
+  //lists, for all other voxels:
+  unsigned int surfaceIndex;
+};
+
+//The surface voxel lists of all surface voxels are stored in compressed
+//sparse row (CSR) form, one pair of arrays per list type. The list of type
+//t of the surface voxel with surfaceIndex s is given by
+//voxels[t][offsets[t][s]] to voxels[t][offsets[t][s+1]-1].
+//There is a SHARED list for each EXTENDED voxel, so offsets[SHARED] is
+//indexed by the position of the extended voxel in voxels[EXTENDED]:
+struct SurfaceVoxels
+{
+  std::vector<unsigned int> offsets[SURFACE_LIST_SIZE];
+  std::vector<Voxel*> voxels[SURFACE_LIST_SIZE];
 };
 
 struct Point 
@@ -163,12 +236,30 @@ struct Comp
   std::vector<Comp*> intersectLowerPeers;
   std::vector<Comp*> lineSubs;
   std::vector<Species*> species;
-  std::vector<unsigned int> coords; //coords[x] = aVoxel->coord - theStartCoord
+  std::vector<unsigned int> coords; //coords[x] = aVoxel - &theLattice[0]
+  //The voxels occupied by vacantID, kept up to date by SpatiocyteStepper
+  //once the lattice has been compartmentalized:
+  std::vector<Voxel*> vacantVoxels;
+};
+
+//The entry of the collision table of SpatiocyteStepper for a walking
+//species colliding with a target species. The reaction occurs if a
+//uniform random integer in [0, 2^32) is below the cutoff, which is 2^32
+//for a reaction that always occurs:
+struct CollisionEntry
+{
+  DiffusionInfluencedReactionProcessInterface* reaction;
+  uint64_t cutoff;
 };
 
-struct Origin
+//The unwrapped global row, layer and col of a molecule and of its origin.
+//They are updated as the molecule walks, so they keep counting across the
+//periodic edges:
+struct Displacement
 {
-  Point point;
+  int originRow;
+  int originLayer;
+  int originCol;
   int row;
   int layer;
   int col;
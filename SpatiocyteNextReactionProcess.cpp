@@ -43,6 +43,11 @@ void SpatiocyteNextReactionProcess::fire()
   std::cout << " aValue2:" << aValue2 << " " << B->size() << std::endl;
   */
 
+  if(getIsBatch())
+    {
+      fireBatch();
+      return;
+    }
   if(theOrder == 0)
     {
       if(C)
@@ -407,25 +412,112 @@ bool SpatiocyteNextReactionProcess::reactACD(Species* a, Species* c, Species* d)
 bool SpatiocyteNextReactionProcess::reactAC(Species* a, Species* c)
 {
   Voxel* moleculeA(a->getRandomMolecule());
-  Voxel* moleculeC(NULL);
+  Voxel* moleculeC(getProductAC(a, c, moleculeA));
+  if(moleculeC == NULL)
+    {
+      //Only proceed if we can find an adjoining vacant voxel
+      //of nonND which can be occupied by C:
+      requeue();
+      return false;
+    }
+  a->removeMolecule(moleculeA);
+  c->addMolecule(moleculeC);
+  return true;
+}
+
+Voxel* SpatiocyteNextReactionProcess::getProductAC(Species* a, Species* c,
+                                                   Voxel* moleculeA)
+{
   if(a->getVacantID() == c->getVacantID() || a->getID() == c->getVacantID())
     {
-      moleculeC = moleculeA;
+      return moleculeA;
     }
-  else
+  return c->getRandomAdjoiningVoxel(moleculeA);
+}
+
+//nonHD_A -> nonHD_C or nonHD_A -> HD_C (+ HD_D) with Batch:
+//Each molecule of A reacts independently with the probability
+//1-exp(-p*t) within the time t since the last batch, so the number of
+//reactions is drawn from the binomial distribution and the reacting
+//molecules are selected without replacement by a partial Fisher-Yates
+//shuffle of the indices of A. The molecules are selected before any of
+//them is removed, since a removal moves the last molecule of A into the
+//removed index. A selected molecule without a vacant voxel for C is
+//blocked: it stays in A until the next batch and its reaction is lost, as
+//it would be if it fired alone. The reactions are executed together at
+//the end of a diffusion interval of A, within the error of the diffusion
+//interval, and the process is requeued and interrupts the dependent
+//processes only once:
+void SpatiocyteNextReactionProcess::fireBatch()
+{
+  const unsigned int aSize(A->size());
+  unsigned int aCount(0);
+  if(aSize)
     {
-      moleculeC = c->getRandomAdjoiningVoxel(moleculeA);
-      if(moleculeC == NULL)
+      aCount = gsl_ran_binomial(getStepper()->getRng(),
+                                1-exp(-p*(theTime-theBatchTime)), aSize);
+    }
+  theBatchIndices.resize(aSize);
+  for(unsigned int i(0); i != aSize; ++i)
+    {
+      theBatchIndices[i] = i;
+    }
+  theBatchMolecules.resize(aCount);
+  for(unsigned int i(0); i != aCount; ++i)
+    {
+      const unsigned int j(i+gsl_rng_uniform_int(getStepper()->getRng(),
+                                                 aSize-i));
+      std::swap(theBatchIndices[i], theBatchIndices[j]);
+      theBatchMolecules[i] = A->getMolecule(theBatchIndices[i]);
+    }
+  unsigned int aReactedSize(0);
+  for(unsigned int i(0); i != aCount; ++i)
+    {
+      Voxel* moleculeA(theBatchMolecules[i]);
+      if(C)
         {
-          //Only proceed if we can find an adjoining vacant voxel
-          //of nonND which can be occupied by C:
-          requeue();
-          return false;
+          Voxel* moleculeC(getProductAC(A, C, moleculeA));
+          if(moleculeC == NULL)
+            {
+              continue;
+            }
+          A->removeMolecule(moleculeA);
+          C->addMolecule(moleculeC);
+        }
+      else
+        {
+          A->removeMolecule(moleculeA);
         }
+      ++aReactedSize;
     }
-  a->removeMolecule(moleculeA);
-  c->addMolecule(moleculeC);
-  return true;
+  if(variableC)
+    {
+      variableC->addValue(aReactedSize);
+    }
+  if(variableD)
+    {
+      variableD->addValue(aReactedSize);
+    }
+  theBatchTime = theTime;
+  ReactionProcess::fire();
+}
+
+//The batch of the current diffusion interval is not postponed by the
+//changes of A, but an idle batch is restarted:
+void SpatiocyteNextReactionProcess::restartBatch(Time aCurrentTime)
+{
+  if(theTime == libecs::INF && A->size())
+    {
+      theBatchTime = aCurrentTime;
+      theTime = aCurrentTime+getStepInterval();
+      thePriorityQueue->moveUp(theQueueID);
+    }
+}
+
+//A is not batched if it does not diffuse:
+bool SpatiocyteNextReactionProcess::getIsBatch() const
+{
+  return isBatch && A->getDiffusionInterval() != libecs::INF;
 }
 
 //HD -> nonHD
@@ -486,6 +578,22 @@ Voxel* SpatiocyteNextReactionProcess::reactvAvBC(Species* c)
 void SpatiocyteNextReactionProcess::initializeThird()
 {
   ReactionProcess::initializeThird();
+  isBatch = false;
+  if(Batch)
+    {
+      if(!(theOrder == 1 && A && ((C && !D && !variableD) ||
+                                  (variableC && !D))))
+        {
+          THROW_EXCEPTION(ValueError, 
+                          String(getPropertyInterface().getClassName()) + 
+                          "[" + getFullID().asString() + 
+                          "]: Batch is only allowed for the first order " +
+                          "nonHD_A -> nonHD_C and nonHD_A -> HD_C (+ HD_D) " +
+                          "reactions.");
+        }
+      isBatch = true;
+      theBatchTime = getStepper()->getCurrentTime();
+    }
   if(p != -1)
     {
       return;
@@ -763,6 +871,14 @@ void SpatiocyteNextReactionProcess::printParameters()
 
 GET_METHOD_DEF(Real, StepInterval, SpatiocyteNextReactionProcess)
 {
+  if(getIsBatch())
+    {
+      if(A->size())
+        {
+          return A->getDiffusionInterval();
+        }
+      return libecs::INF;
+    }
   double step(getPropensity_R()*(-log(gsl_rng_uniform_pos(getStepper()->getRng()))));
   /*
   std::cout << getFullID().asString() << " " << theTime <<  " next:" << theTime+step << " interval:" << step << std::endl; 
@@ -36,8 +36,11 @@
 #include <sstream>
 #include <MethodProxy.hpp>
 #include "ReactionProcess.hpp"
+#include "ReactionGroup.hpp"
+#include "TauLeapGroup.hpp"
+#include "SpatiocyteNextReactionProcessInterface.hpp"
 
-LIBECS_DM_CLASS(SpatiocyteNextReactionProcess, ReactionProcess)
+LIBECS_DM_CLASS_EXTRA_1(SpatiocyteNextReactionProcess, ReactionProcess, SpatiocyteNextReactionProcessInterface)
 { 
   typedef MethodProxy<SpatiocyteNextReactionProcess, Real> RealMethodProxy; 
   typedef Real (SpatiocyteNextReactionProcess::*PDMethodPtr)(Variable*);
@@ -48,9 +51,12 @@ public:
       PROPERTYSLOT_SET_GET(Real, SpaceA);
       PROPERTYSLOT_SET_GET(Real, SpaceB);
       PROPERTYSLOT_SET_GET(Real, SpaceC);
+      PROPERTYSLOT_SET_GET(Integer, Batch);
       PROPERTYSLOT_GET_NO_LOAD_SAVE(Real, Propensity);
     }
   SpatiocyteNextReactionProcess():
+    Batch(false),
+    isBatch(false),
     initSizeA(0),
     initSizeB(0),
     initSizeC(0),
@@ -58,12 +64,17 @@ public:
     SpaceA(0),
     SpaceB(0),
     SpaceC(0),
+    theBatchTime(0),
+    theGroupIndex(0),
+    theReactionGroup(NULL),
+    theTauLeapGroup(NULL),
     theGetPropensityMethodPtr(RealMethodProxy::create<
             &SpatiocyteNextReactionProcess::getPropensity_ZerothOrder>()) {}
   virtual ~SpatiocyteNextReactionProcess() {}
   SIMPLE_SET_GET_METHOD(Real, SpaceA);
   SIMPLE_SET_GET_METHOD(Real, SpaceB);
   SIMPLE_SET_GET_METHOD(Real, SpaceC);
+  SIMPLE_SET_GET_METHOD(Integer, Batch);
   virtual void initialize()
     {
       if(isInitialized)
@@ -145,6 +156,79 @@ public:
     {
       return true;
     }
+  //With the SpatiocyteStepper GroupReactions, the process is not in the
+  //priority queue but is fired by its ReactionGroup:
+  virtual void setReactionGroup(ReactionGroup* aReactionGroup,
+                                unsigned int anIndex)
+    {
+      theReactionGroup = aReactionGroup;
+      theGroupIndex = anIndex;
+    }
+  virtual double getGroupPropensity()
+    {
+      return getPropensity();
+    }
+  virtual void fireGroup(Time aCurrentTime)
+    {
+      theTime = aCurrentTime;
+      fire();
+    }
+  //With the SpatiocyteStepper TauLeap, the HD reactions are not in the
+  //priority queue but are fired by the TauLeapGroup:
+  virtual void setTauLeapGroup(TauLeapGroup* aTauLeapGroup,
+                               unsigned int anIndex)
+    {
+      theTauLeapGroup = aTauLeapGroup;
+      theGroupIndex = anIndex;
+    }
+  virtual bool isHDReaction()
+    {
+      return !A && !B && !C && !D && !E &&
+        (variableA || variableB || variableC || variableD || variableE);
+    }
+  virtual void fireLeap(Time aCurrentTime, unsigned int aCount)
+    {
+      for(VariableReferenceVector::iterator
+          i(theVariableReferenceVector.begin());
+          i != theVariableReferenceVector.end(); ++i)
+        {
+          (*i).getVariable()->addValue((*i).getCoefficient()*
+                                       double(aCount));
+        }
+      for(std::vector<ReactionProcess*>::const_iterator 
+          i(theInterruptingProcesses.begin());
+          i!=theInterruptingProcesses.end(); ++i)
+        {
+          (*i)->substrateValueChanged(aCurrentTime);
+        }
+    }
+  virtual bool getIsBatch() const;
+  virtual void requeue()
+    {
+      if(!theReactionGroup && !theTauLeapGroup)
+        {
+          ReactionProcess::requeue();
+        }
+    }
+  virtual void substrateValueChanged(Time aCurrentTime)
+    {
+      if(getIsBatch())
+        {
+          restartBatch(aCurrentTime);
+        }
+      else if(theTauLeapGroup)
+        {
+          theTauLeapGroup->update(theGroupIndex, aCurrentTime);
+        }
+      else if(theReactionGroup)
+        {
+          theReactionGroup->update(theGroupIndex, aCurrentTime);
+        }
+      else
+        {
+          ReactionProcess::substrateValueChanged(aCurrentTime);
+        }
+    }
   virtual GET_METHOD(Real, StepInterval);
   virtual void fire();
   virtual void initializeThird();
@@ -153,6 +237,9 @@ protected:
   virtual void calculateOrder();
   virtual bool reactACD(Species*, Species*, Species*);
   virtual bool reactAC(Species*, Species*);
+  virtual Voxel* getProductAC(Species*, Species*, Voxel*);
+  virtual void fireBatch();
+  virtual void restartBatch(Time);
   virtual Voxel* reactvAC(Variable*, Species*);
   virtual Comp* getComp2D(Species*);
   virtual Voxel* reactvAvBC(Species*);
@@ -203,6 +290,8 @@ protected:
         }
     }
 protected:
+  bool Batch;
+  bool isBatch;
   double initSizeA;
   double initSizeB;
   double initSizeC;
@@ -210,6 +299,12 @@ protected:
   double SpaceA;
   double SpaceB;
   double SpaceC;
+  Time theBatchTime;
+  unsigned int theGroupIndex;
+  std::vector<unsigned int> theBatchIndices;
+  std::vector<Voxel*> theBatchMolecules;
+  ReactionGroup* theReactionGroup;
+  TauLeapGroup* theTauLeapGroup;
   std::stringstream pFormula;
   RealMethodProxy theGetPropensityMethodPtr;  
 };
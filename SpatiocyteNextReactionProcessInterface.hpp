@@ -0,0 +1,57 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+
+#ifndef __SPATIOCYTENEXTREACTIONPROCESSINTERFACE_HPP
+#define __SPATIOCYTENEXTREACTIONPROCESSINTERFACE_HPP
+
+#include "SpatiocyteCommon.hpp"
+
+class ReactionGroup;
+class TauLeapGroup;
+
+class SpatiocyteNextReactionProcessInterface
+{ 
+public:
+  virtual ~SpatiocyteNextReactionProcessInterface() {}
+  virtual void setReactionGroup(ReactionGroup*, unsigned int) = 0;
+  virtual double getGroupPropensity() = 0;
+  virtual void fireGroup(Time) = 0;
+  //Fires the events of each diffusion interval of A at once, so it is
+  //queued on its own instead of in a group:
+  virtual bool getIsBatch() const = 0;
+  virtual void setTauLeapGroup(TauLeapGroup*, unsigned int) = 0;
+  //All reactants and products are HD variables:
+  virtual bool isHDReaction() = 0;
+  //Fires the reaction aCount times at once with the tau-leaping:
+  virtual void fireLeap(Time, unsigned int aCount) = 0;
+};
+
+#endif /* __SPATIOCYTENEXTREACTIONPROCESSINTERFACE_HPP */
@@ -35,7 +35,8 @@ LIBECS_DM_INIT(SpatiocyteProcess, Process);
 
 String SpatiocyteProcess::getIDString(Voxel* aVoxel) const
 {
-  Variable* aVariable(theSpecies[aVoxel->id]->getVariable());
+  Variable* aVariable(theSpecies[theSpatiocyteStepper->getID(aVoxel)
+                      ]->getVariable());
   return "["+aVariable->getSystemPath().asString()+":"+aVariable->getID()+"]";
 }
 
@@ -0,0 +1,151 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+
+
+#ifndef __SpatiocyteRandom_hpp
+#define __SpatiocyteRandom_hpp
+
+#include <stdint.h>
+#include <gsl/gsl_rng.h>
+#include "SpatiocyteCommon.hpp"
+
+//The random variates of a species or thread. With GSL_RANDOM, they are
+//drawn directly from the gsl_rng, in the same order as before, so that a
+//model reproduces its trajectories for a given seed. With PHILOX_RANDOM,
+//they are taken from a buffer of uniform variates in [0, 1) that is filled
+//in bulk from the counter-based Philox4x32-10 generator. A Philox stream is
+//fully determined by its key (the seed) and its counter (the block number,
+//species ID and thread), so every species and thread gets an independent
+//and reproducible stream without any shared state.
+class RandomBuffer
+{
+public:
+  RandomBuffer():
+    theEngine(GSL_RANDOM),
+    theIndex(RANDOM_BUFFER_SIZE),
+    theBlock(0),
+    theRng(NULL) {}
+  void setGslEngine(const gsl_rng* aRng)
+    {
+      theEngine = GSL_RANDOM;
+      theRng = aRng;
+      theIndex = RANDOM_BUFFER_SIZE;
+    }
+  void setPhiloxEngine(unsigned long int aSeed, unsigned int aStream,
+                       unsigned int aThread)
+    {
+      theEngine = PHILOX_RANDOM;
+      theKey[0] = static_cast<uint32_t>(aSeed);
+      theKey[1] = static_cast<uint32_t>(
+                         static_cast<unsigned long long>(aSeed) >> 32);
+      theStream = aStream;
+      theThread = aThread;
+      theBlock = 0;
+      theIndex = RANDOM_BUFFER_SIZE;
+    }
+  double uniform()
+    {
+      if(theEngine == GSL_RANDOM)
+        {
+          return gsl_rng_uniform(theRng);
+        }
+      if(theIndex == RANDOM_BUFFER_SIZE)
+        {
+          fill();
+        }
+      return theBuffer[theIndex++];
+    }
+  //Returns an integer in [0, 2^32), which is exact for PHILOX_RANDOM:
+  uint32_t uniformUInt32()
+    {
+      return static_cast<uint32_t>(uniform()*4294967296.0);
+    }
+  //Returns an integer in [0, aSize):
+  unsigned int uniformInt(unsigned int aSize)
+    {
+      if(theEngine == GSL_RANDOM)
+        {
+          return gsl_rng_uniform_int(theRng, aSize);
+        }
+      return static_cast<unsigned int>(uniform()*aSize);
+    }
+private:
+  void fill()
+    {
+      //The blocks are independent of each other, which allows the
+      //compiler to vectorize this loop:
+      for(unsigned int i(0); i != RANDOM_BUFFER_SIZE; i += 4)
+        {
+          uint32_t aBlock[4] = {static_cast<uint32_t>(theBlock),
+            static_cast<uint32_t>(theBlock >> 32), theStream, theThread};
+          philox(aBlock);
+          for(unsigned int j(0); j != 4; ++j)
+            {
+              theBuffer[i+j] = aBlock[j]*2.3283064365386963e-10;
+            }
+          ++theBlock;
+        }
+      theIndex = 0;
+    }
+  //Philox4x32 with 10 rounds (Salmon et al., SC11, 2011):
+  void philox(uint32_t* aCounter) const
+    {
+      uint32_t aKey[2] = {theKey[0], theKey[1]};
+      for(unsigned int i(0); i != 10; ++i)
+        {
+          const uint64_t aProduct0(static_cast<uint64_t>(0xD2511F53U)*
+                                   aCounter[0]);
+          const uint64_t aProduct1(static_cast<uint64_t>(0xCD9E8D57U)*
+                                   aCounter[2]);
+          const uint32_t aCounter0(static_cast<uint32_t>(aProduct1 >> 32)^
+                                   aCounter[1]^aKey[0]);
+          const uint32_t aCounter2(static_cast<uint32_t>(aProduct0 >> 32)^
+                                   aCounter[3]^aKey[1]);
+          aCounter[0] = aCounter0;
+          aCounter[1] = static_cast<uint32_t>(aProduct1);
+          aCounter[2] = aCounter2;
+          aCounter[3] = static_cast<uint32_t>(aProduct0);
+          aKey[0] += 0x9E3779B9U;
+          aKey[1] += 0xBB67AE85U;
+        }
+    }
+private:
+  unsigned int theEngine;
+  unsigned int theIndex;
+  uint32_t theKey[2];
+  uint32_t theStream;
+  uint32_t theThread;
+  uint64_t theBlock;
+  const gsl_rng* theRng;
+  double theBuffer[RANDOM_BUFFER_SIZE];
+};
+
+#endif /* __SpatiocyteRandom_hpp */
@@ -25,8 +25,10 @@
 #define __SpatiocyteSpecies_hpp
 
 #include <sstream>
+#include <algorithm>
 #include <Variable.hpp>
 #include "SpatiocyteCommon.hpp"
+#include "SpatiocyteRandom.hpp"
 #include "SpatiocyteStepper.hpp"
 #include "SpatiocyteProcessInterface.hpp"
 #include "DiffusionInfluencedReactionProcessInterface.hpp"
@@ -48,11 +50,20 @@ String int2str(int anInt)
   return aStream.str();
 }
 
+//A reactive collision found by a thread during a threaded walk. It is
+//resolved serially after all the sectors have been walked:
+struct Collision
+{
+  Voxel* source;
+  Voxel* target;
+  unsigned short targetID;
+};
+
 class Species
 {
 public:
   Species(SpatiocyteStepper* aStepper, Variable* aVariable, int anID, 
-          int anInitMoleculeSize, const gsl_rng* aRng):
+          int anInitMoleculeSize):
     isDiffuseVacant(false),
     isVacant(false),
     isVolume(false),
@@ -60,43 +71,61 @@ public:
     isDiffusing(false),
     isGaussianPopulation(false),
     isInContact(false),
+    isDisplacementTracked(false),
+    isPeriodic(false),
     isPolymer(false),
     isStatic(true),
     isSubunitInitialized(false),
     theID(anID),
     theInitMoleculeSize(anInitMoleculeSize),
     theMoleculeSize(0),
+    theWalkCount(0),
     D(0),
     theDiffusionInterval(libecs::INF),
     theWalkProbability(1),
-    theRng(aRng),
     thePopulateProcess(NULL),
     theStepper(aStepper),
-    theVariable(aVariable) {}
+    theVariable(aVariable),
+    theCollisionRow(NULL) {}
   ~Species() {}
   void initialize(int speciesSize, int anAdjoiningVoxelSize)
     {
       theAdjoiningVoxelSize = anAdjoiningVoxelSize;
       theReactionProbabilities.resize(speciesSize);
-      theDiffusionInfluencedReactions.resize(speciesSize);
       theFinalizeReactions.resize(speciesSize);
       for(int i(0); i != speciesSize; ++ i)
         {
-          theDiffusionInfluencedReactions[i] = NULL;
           theReactionProbabilities[i] = 0;
           theFinalizeReactions[i] = false;
         }
+      theCollisionRow = theStepper->getCollisionRow(theID);
       if(theComp)
         {
           setVacantSpecies(theStepper->id2species(theComp->vacantID));
         }
+      initRandoms();
+    }
+  //Each species has its own random stream and, for the threaded walk, one
+  //stream per thread:
+  void initRandoms()
+    {
+      theStepper->initRandom(theRandom, theID, 0);
+      if(theStepper->getThreadSize() > 1)
+        {
+          theThreadRandoms.resize(theStepper->getThreadSize());
+          for(unsigned int i(0); i != theThreadRandoms.size(); ++i)
+            {
+              theStepper->initRandom(theThreadRandoms[i], theID, i+1);
+            }
+        }
     }
   void setDiffusionInfluencedReaction(
                                     DiffusionInfluencedReactionProcessInterface*
                                       aReaction, int anID, double aProbability)
     {
-      theDiffusionInfluencedReactions[anID] = aReaction;
+      theCollisionRow[anID].reaction = aReaction;
       theReactionProbabilities[anID] = aProbability;
+      theCollisionRow[anID].cutoff = getCollisionCutoff(aProbability);
     }
   void setDiffusionInfluencedReactantPair(Species* aSpecies)
     {
@@ -248,21 +277,28 @@ public:
     {
       return theID;
     }
+  //Only the molecules that have walked since initDisplacements was called
+  //contribute displacements, which are computed from the unwrapped global
+  //coordinates without looking up the voxels of the molecules:
   double getMeanSquaredDisplacement()
     {
-      if(!theMoleculeSize)
+      if(!theMoleculeSize || !isDisplacementTracked)
         {
           return 0;
         }
       double aDisplacement(0);
       for(unsigned int i(0); i < theMoleculeSize; ++i)
         {
-          Point aCurrentPoint(theStepper->getPeriodicPoint(
-                                                 theMolecules[i]->coord,
-                                                 getIsVolume(),
-                                                 &theMoleculeOrigins[i]));
-          double aDistance(getDistance(&theMoleculeOrigins[i].point,
-                                       &aCurrentPoint));
+          const Displacement& aMoleculeDisplacement(theDisplacements[i]);
+          Point anOriginPoint(theStepper->global2point(
+                                     aMoleculeDisplacement.originRow,
+                                     aMoleculeDisplacement.originLayer,
+                                     aMoleculeDisplacement.originCol));
+          Point aCurrentPoint(theStepper->global2point(
+                                     aMoleculeDisplacement.row,
+                                     aMoleculeDisplacement.layer,
+                                     aMoleculeDisplacement.col));
+          double aDistance(getDistance(&anOriginPoint, &aCurrentPoint));
           aDisplacement += aDistance*aDistance;
         }
       return
@@ -390,15 +426,249 @@ public:
         {
           if(theFinalizeReactions[i])
             {
-              theDiffusionInfluencedReactions[i]->finalizeReaction();
+              theCollisionRow[i].reaction->finalizeReaction();
             }
         }
+      theStepper->notifyInterrupts();
+    }
+  bool getIsThreadedWalk() const
+    {
+      return theStepper->getThreadSize() > 1 &&
+        theMoleculeSize >= MIN_THREADED_WALK_SIZE;
+    }
+  //Must be called before every walk of the molecules, including the
+  //walks of a DiffusionGroup sweep:
+  void prepareWalk()
+    {
+      if(theStepper->getSortInterval() &&
+         ++theWalkCount >= theStepper->getSortInterval())
+        {
+          sortMolecules();
+          theWalkCount = 0;
+        }
     }
   void walk()
     {
-      for(unsigned int i(0); i < theMoleculeSize; ++i)
+      prepareWalk();
+      if(getIsThreadedWalk())
         {
-          Voxel* source(theMolecules[i]);
+          walkThreaded();
+          return;
+        }
+      for(unsigned int i(0); i < theMoleculeSize; )
+        {
+          if(!walkMolecule(i))
+            {
+              ++i;
+            }
+        }
+    }
+  //Sorts theMolecules in the memory order of their voxels, which become
+  //scattered over the lattice as the molecules walk, so that the walk
+  //accesses the lattice mostly in order. The order of the sorted blocks of
+  //MOLECULE_SORT_BLOCK_SIZE molecules is shuffled to avoid always walking
+  //the molecules in the same direction across the lattice:
+  void sortMolecules()
+    {
+      std::vector<std::pair<Voxel*, unsigned int> > 
+        aSortedMolecules(theMoleculeSize);
+      for(unsigned int i(0); i != theMoleculeSize; ++i)
+        {
+          aSortedMolecules[i] = std::make_pair(theMolecules[i], i);
+        }
+      std::sort(aSortedMolecules.begin(), aSortedMolecules.end());
+      std::vector<unsigned int> aBlocks((theMoleculeSize+
+        MOLECULE_SORT_BLOCK_SIZE-1)/MOLECULE_SORT_BLOCK_SIZE);
+      for(unsigned int i(0); i != aBlocks.size(); ++i)
+        {
+          aBlocks[i] = i;
+        }
+      for(unsigned int i(aBlocks.size()); i > 1; --i)
+        {
+          std::swap(aBlocks[i-1], aBlocks[theRandom.uniformInt(i)]);
+        }
+      std::vector<Displacement> aDisplacements;
+      unsigned int anIndex(0);
+      for(unsigned int i(0); i != aBlocks.size(); ++i)
+        {
+          const unsigned int aBegin(aBlocks[i]*MOLECULE_SORT_BLOCK_SIZE);
+          const unsigned int anEnd(std::min(aBegin+MOLECULE_SORT_BLOCK_SIZE,
+                                            theMoleculeSize));
+          for(unsigned int j(aBegin); j != anEnd; ++j)
+            {
+              setMolecule(anIndex++, aSortedMolecules[j].first);
+              if(isDisplacementTracked)
+                {
+                  aDisplacements.push_back(
+                     theDisplacements[aSortedMolecules[j].second]);
+                }
+            }
+        }
+      if(isDisplacementTracked)
+        {
+          std::copy(aDisplacements.begin(), aDisplacements.end(),
+                    theDisplacements.begin());
+        }
+    }
+  //Walks the molecule at anIndex of theMolecules. Returns true if the
+  //molecule has reacted and another molecule has been moved into anIndex,
+  //which must then be walked next:
+  bool walkMolecule(unsigned int anIndex)
+    {
+      Voxel* source(theMolecules[anIndex]);
+      int size;
+      if(isVolume)
+        {
+          size = theAdjoiningVoxelSize;
+        }
+      else
+        {
+          size = source->adjoiningSize;
+        }
+      Voxel* target(theStepper->getAdjoiningVoxel(source,
+                    theRandom.uniformInt(size)));
+      if(source == target)
+        {
+          std::cout << "SpatiocyteSpecies source == target error" <<
+            std::endl;
+        }
+      const unsigned short targetID(theStepper->getID(target));
+      if(targetID == theVacantID)
+        {
+          if(theWalkProbability == 1 ||
+             theRandom.uniform() < theWalkProbability)
+            {
+              theStepper->swapID(source, target);
+              setMolecule(anIndex, target);
+              addBoundaryMolecule(target, 0);
+              if(isDisplacementTracked)
+                {
+                  theStepper->addDisplacement(source, target,
+                                              theDisplacements[anIndex]);
+                }
+            }
+        }
+      else
+        {
+          const CollisionEntry& anEntry(theCollisionRow[targetID]);
+          //If it meets the reaction probability:
+          if(anEntry.reaction && theRandom.uniformUInt32() < anEntry.cutoff)
+            { 
+              Species* targetSpecies(theStepper->id2species(targetID));
+              DiffusionInfluencedReactionProcessInterface* aReaction(
+                                                           anEntry.reaction);
+              //Soft remove the target and the source molecules, i.e.,
+              //keep the ids intact, before the reaction so that the
+              //products can be added at the same voxels without
+              //duplicating the molecules in the lists:
+              const unsigned int targetIndex(
+                             theStepper->getMoleculeIndex(target));
+              const Displacement aTargetDisplacement(
+                          targetSpecies->getDisplacement(targetIndex));
+              targetSpecies->softRemoveMolecule(target);
+              const unsigned int sourceIndex(
+                             theStepper->getMoleculeIndex(source));
+              const Displacement aSourceDisplacement(
+                                          getDisplacement(sourceIndex));
+              softRemoveMolecule(source);
+              if(aReaction->react(source, target))
+                {
+                  theFinalizeReactions[targetSpecies->getID()] = true;
+                  carryDisplacement(source, aSourceDisplacement);
+                  targetSpecies->carryDisplacement(target,
+                                                   aTargetDisplacement);
+                  return anIndex < theMoleculeSize;
+                }
+              restoreMolecule(source, sourceIndex);
+              targetSpecies->restoreMolecule(target, targetIndex);
+            }
+        }
+      return false;
+    }
+  //The molecules are binned into the column sectors of the lattice, and
+  //each thread walks the molecules of its even sector and then, after all
+  //threads have completed, its odd sector. Since a sector is wider than the
+  //reach of a walk step, neighboring threads never modify the same voxel.
+  //Collisions that satisfy the reaction probability are only recorded by
+  //the threads and executed serially afterwards because the reactions
+  //modify the molecule lists of other species:
+  void walkThreaded()
+    {
+      const unsigned int aThreadSize(theStepper->getThreadSize());
+      theSectorMolecules.resize(aThreadSize*2);
+      theCollisions.resize(aThreadSize);
+      for(unsigned int i(0); i != theSectorMolecules.size(); ++i)
+        {
+          theSectorMolecules[i].clear();
+        }
+      for(unsigned int i(0); i != aThreadSize; ++i)
+        {
+          theCollisions[i].clear();
+        }
+      for(unsigned int i(0); i != theMoleculeSize; ++i)
+        {
+          theSectorMolecules[theStepper->getSector(theMolecules[i])
+            ].push_back(i);
+        }
+      theStepper->runThreads(&Species::walkSectors, this);
+      for(unsigned int i(0); i != aThreadSize; ++i)
+        {
+          for(std::vector<Collision>::const_iterator j(
+              theCollisions[i].begin()); j != theCollisions[i].end(); ++j)
+            {
+              //Skip if the source or the target molecule has already
+              //reacted in an earlier collision:
+              if(theStepper->getID(j->source) != theID ||
+                 theStepper->getID(j->target) != j->targetID)
+                {
+                  continue;
+                }
+              Species* targetSpecies(theStepper->id2species(j->targetID));
+              const unsigned int targetIndex(
+                             theStepper->getMoleculeIndex(j->target));
+              const Displacement aTargetDisplacement(
+                          targetSpecies->getDisplacement(targetIndex));
+              targetSpecies->softRemoveMolecule(j->target);
+              const unsigned int sourceIndex(
+                             theStepper->getMoleculeIndex(j->source));
+              const Displacement aSourceDisplacement(
+                                          getDisplacement(sourceIndex));
+              softRemoveMolecule(j->source);
+              if(theCollisionRow[j->targetID].reaction->react(j->source,
+                                                              j->target))
+                {
+                  theFinalizeReactions[targetSpecies->getID()] = true;
+                  carryDisplacement(j->source, aSourceDisplacement);
+                  targetSpecies->carryDisplacement(j->target,
+                                                   aTargetDisplacement);
+                }
+              else
+                {
+                  restoreMolecule(j->source, sourceIndex);
+                  targetSpecies->restoreMolecule(j->target, targetIndex);
+                }
+            }
+        }
+    }
+  static void walkSectors(void* aSpecies, unsigned int aThread)
+    {
+      static_cast<Species*>(aSpecies)->walkSectors(aThread);
+    }
+  void walkSectors(unsigned int aThread)
+    {
+      walkSector(theSectorMolecules[aThread*2], aThread);
+      theStepper->waitThreads();
+      walkSector(theSectorMolecules[aThread*2+1], aThread);
+    }
+  void walkSector(const std::vector<unsigned int>& aSectorMolecules,
+                  unsigned int aThread)
+    {
+      RandomBuffer& aRandom(theThreadRandoms[aThread]);
+      std::vector<Collision>& aCollisions(theCollisions[aThread]);
+      for(std::vector<unsigned int>::const_iterator i(
+          aSectorMolecules.begin()); i != aSectorMolecules.end(); ++i)
+        {
+          Voxel* source(theMolecules[*i]);
           int size;
           if(isVolume)
             {
@@ -408,41 +678,32 @@ public:
             {
               size = source->adjoiningSize;
             }
-          Voxel* target(source->adjoiningVoxels[
-                        gsl_rng_uniform_int(theRng, size)]);
-          if(source == target)
-            {
-              std::cout << "SpatiocyteSpecies source == target error" <<
-                std::endl;
-            }
-          if(target->id == theVacantID)
+          Voxel* target(theStepper->getAdjoiningVoxel(source,
+                        aRandom.uniformInt(size)));
+          const unsigned short targetID(theStepper->getID(target));
+          if(targetID == theVacantID)
             {
               if(theWalkProbability == 1 ||
-                 gsl_rng_uniform(theRng) < theWalkProbability)
+                 aRandom.uniform() < theWalkProbability)
                 {
-                  target->id = theID;
-                  source->id = theVacantID;
-                  theMolecules[i] = target;
+                  theStepper->swapID(source, target);
+                  setMolecule(*i, target);
+                  addBoundaryMolecule(target, aThread);
+                  if(isDisplacementTracked)
+                    {
+                      theStepper->addDisplacement(source, target,
+                                                  theDisplacements[*i]);
+                    }
                 }
             }
-          else if(theDiffusionInfluencedReactions[target->id] != NULL)
+          else
             {
-              //If it meets the reaction probability:
-              if(gsl_rng_uniform(theRng) < theReactionProbabilities[target->id])
+              const CollisionEntry& anEntry(theCollisionRow[targetID]);
+              if(anEntry.reaction &&
+                 aRandom.uniformUInt32() < anEntry.cutoff)
                 { 
-                  Species* targetSpecies(theStepper->id2species(target->id));
-                  DiffusionInfluencedReactionProcessInterface* aReaction(
-                             theDiffusionInfluencedReactions[target->id]);
-                  if(aReaction->react(source, target))
-                    {
-                      //Soft remove the source molecule, i.e.,
-                      //keep the id intact:
-                      theMolecules[i--] = theMolecules[--theMoleculeSize];
-                      theVariable->setValue(theMoleculeSize);
-                      //Soft remove the target molecule:
-                      targetSpecies->softRemoveMolecule(target);
-                      theFinalizeReactions[targetSpecies->getID()] = true;
-                    }
+                  Collision aCollision = {source, target, targetID};
+                  aCollisions.push_back(aCollision);
                 }
             }
         }
@@ -462,27 +723,27 @@ public:
             {
               size = source->adjoiningSize;
             }
-          Voxel* target(source->adjoiningVoxels[
-                        gsl_rng_uniform_int(theRng, size)]);
-          if(target->id == theVacantID)
+          Voxel* target(theStepper->getAdjoiningVoxel(source,
+                        theRandom.uniformInt(size)));
+          const unsigned short targetID(theStepper->getID(target));
+          if(targetID == theVacantID)
             {
               if(theWalkProbability == 1 ||
-                 gsl_rng_uniform(theRng) < theWalkProbability)
+                 theRandom.uniform() < theWalkProbability)
                 {
-                  target->id = theID;
-                  source->id = theVacantID;
+                  theStepper->swapID(source, target);
+                  addBoundaryMolecule(target, 0);
                 }
             }
           /*
-          else if(theDiffusionInfluencedReactions[target->id] != NULL)
+          else if(theDiffusionInfluencedReactions[targetID] != NULL)
             {
               //If it meets the reaction probability:
-              if(gsl_rng_uniform(theRng) <
-                 theReactionProbabilities[target->id])
+              if(theRandom.uniform() < theReactionProbabilities[targetID])
                 { 
-                  Species* targetSpecies(theStepper->id2species(target->id));
+                  Species* targetSpecies(theStepper->id2species(targetID));
                   DiffusionInfluencedReactionProcessInterface* aReaction(
-                             theDiffusionInfluencedReactions[target->id]);
+                             theDiffusionInfluencedReactions[targetID]);
                   if(aReaction->react(source, target))
                     {
                       //Soft remove the target molecule:
@@ -506,14 +767,24 @@ public:
     {
       theVariable = aVariable;
     }
+  //The molecule list of a diffuse vacant species is kept up to date by
+  //SpatiocyteStepper::setID and swapID as the molecules move, so only its
+  //size needs to be synchronized here. The vacant voxels of a Comp are
+  //tracked by the Comp instead, so its vacant species is still rebuilt:
   void updateDiffuseVacantMolecules()
     {
+      if(!getIsVacant())
+        {
+          theMoleculeSize = theMolecules.size();
+          theVariable->setValue(theMoleculeSize);
+          return;
+        }
       theMoleculeSize = 0;
       int aSize(theComp->coords.size());
       for(int i(0); i != aSize; ++i)
         { 
           Voxel* aMolecule(theStepper->coord2voxel(theComp->coords[i]));
-          if(aMolecule->id == theID)
+          if(theStepper->getID(aMolecule) == theID)
             {
               ++theMoleculeSize;
               if(theMoleculeSize > theMolecules.size())
@@ -530,19 +801,13 @@ public:
     }
   void addMolecule(Voxel* aMolecule)
     {
-      aMolecule->id = theID;
+      theStepper->setID(aMolecule, theID);
       if(!getIsVacant() && !getIsDiffuseVacant())
         {
-          ++theMoleculeSize;
-          if(theMoleculeSize > theMolecules.size())
-            {
-              theMolecules.push_back(aMolecule);
-            }
-          else
-            {
-              theMolecules[theMoleculeSize-1] = aMolecule;
-            }
+          setMolecule(theMoleculeSize++, aMolecule);
           theVariable->setValue(theMoleculeSize);
+          addBoundaryMolecule(aMolecule, 0);
+          initDisplacement(theMoleculeSize-1);
         }
     }
   //it is soft remove because the id of the molecule is not changed:
@@ -550,14 +815,15 @@ public:
     {
       if(!getIsVacant() && !getIsDiffuseVacant())
         {
-          for(unsigned int i(0); i < theMoleculeSize; ++i)
+          const unsigned int i(theStepper->getMoleculeIndex(aMolecule));
+          if(i < theMoleculeSize && theMolecules[i] == aMolecule)
             {
-              if(theMolecules[i] == aMolecule)
+              if(i != --theMoleculeSize)
                 {
-                  theMolecules[i] = theMolecules[--theMoleculeSize];
-                  theVariable->setValue(theMoleculeSize);
-                  return;
+                  setMolecule(i, theMolecules[theMoleculeSize]);
+                  swapDisplacements(i, theMoleculeSize);
                 }
+              theVariable->setValue(theMoleculeSize);
             }
         }
     }
@@ -565,29 +831,56 @@ public:
     {
       if(!getIsVacant() && !getIsDiffuseVacant())
         {
-          for(unsigned int i(0); i < theMoleculeSize; ++i)
+          const unsigned int i(theStepper->getMoleculeIndex(aMolecule));
+          if(i < theMoleculeSize && theMolecules[i] == aMolecule)
             {
-              if(theMolecules[i] == aMolecule)
+              theStepper->setID(aMolecule, theVacantID);
+              if(i != --theMoleculeSize)
                 {
-                  aMolecule->id = theVacantID;
-                  theMolecules[i] = theMolecules[--theMoleculeSize];
-                  theVariable->setValue(theMoleculeSize);
-                  return;
+                  setMolecule(i, theMolecules[theMoleculeSize]);
+                  swapDisplacements(i, theMoleculeSize);
                 }
+              theVariable->setValue(theMoleculeSize);
+            }
+        }
+    }
+  //Reverts softRemoveMolecule(aMolecule) when the molecule was at anIndex
+  //of the list, by moving the molecule that replaced it back to the end
+  //of the list:
+  void restoreMolecule(Voxel* aMolecule, unsigned int anIndex)
+    {
+      if(!getIsVacant() && !getIsDiffuseVacant())
+        {
+          if(anIndex != theMoleculeSize)
+            {
+              setMolecule(theMoleculeSize, theMolecules[anIndex]);
+              swapDisplacements(anIndex, theMoleculeSize);
             }
+          setMolecule(anIndex, aMolecule);
+          ++theMoleculeSize;
+          theVariable->setValue(theMoleculeSize);
         }
     }
   //Used by the SpatiocyteStepper when resetting an interation, so must
   //clear the whole compartment using theComp->vacantID:
   void removeMolecules()
     {
-      if(getIsDiffuseVacant())
+      if(getIsDiffuseVacant() && !getIsVacant())
+        {
+          //setID removes the molecule from the tracked list:
+          while(!theMolecules.empty())
+            {
+              theStepper->setID(theMolecules.back(), theComp->vacantID);
+            }
+          theMoleculeSize = 0;
+        }
+      else if(getIsDiffuseVacant())
         {
           updateDiffuseVacantMolecules();
         }
       for(unsigned int i(0); i < theMoleculeSize; ++i)
         {
-          theMolecules[i]->id = theComp->vacantID;
+          theStepper->setID(theMolecules[i], theComp->vacantID);
         }
       theMoleculeSize = 0;
       theVariable->setValue(theMoleculeSize);
@@ -600,16 +893,36 @@ public:
     {
       return theInitMoleculeSize;
     }
-  void initMoleculeOrigins()
+  //From here on the unwrapped displacement of every molecule from its
+  //origin, the voxel it occupies now or where it is added later, is
+  //updated as it walks. The list of a diffuse vacant species is reordered
+  //by the SpatiocyteStepper, so it cannot be tracked:
+  void initDisplacements()
     {
-      theMoleculeOrigins.resize(theMoleculeSize);
+      if(getIsVacant() || getIsDiffuseVacant())
+        {
+          return;
+        }
+      isDisplacementTracked = true;
+      theDisplacements.resize(theMoleculeSize);
       for(unsigned int i(0); i < theMoleculeSize; ++i)
         {
-          Origin& anOrigin(theMoleculeOrigins[i]);
-          anOrigin.point = theStepper->coord2point(theMolecules[i]->coord);
-          anOrigin.row = 0;
-          anOrigin.layer = 0;
-          anOrigin.col = 0;
+          initDisplacement(i);
+        }
+    }
+  void initBoundaryMolecules()
+    {
+      //From here on the molecules that move onto a periodic boundary are
+      //reported to relocateBoundaryMolecules:
+      isPeriodic = true;
+      theBoundaryMolecules.resize(theStepper->getThreadSize());
+      if(getIsDiffuseVacant())
+        {
+          updateDiffuseVacantMolecules();
+        }
+      for(unsigned int i(0); i < theMoleculeSize; ++i)
+        {
+          addBoundaryMolecule(theMolecules[i], 0);
         }
     }
   void removeBoundaryMolecules()
@@ -624,24 +937,64 @@ public:
         }
       theVariable->setValue(theMoleculeSize);
     }
+  //Only the molecules reported by addBoundaryMolecule are relocated. A
+  //reported molecule that has since moved away or reacted is skipped, while
+  //one that could not be relocated because its periodic voxel is occupied
+  //is kept for the next call:
   void relocateBoundaryMolecules()
     {
-      for(unsigned int i(0); i < theMoleculeSize; ++i)
+      std::vector<Voxel*> aPendingMolecules;
+      for(unsigned int i(0); i != theBoundaryMolecules.size(); ++i)
         {
-          Origin anOrigin(theMoleculeOrigins[i]);
-          Voxel* periodicVoxel(theStepper->getPeriodicVoxel(
-                                                theMolecules[i]->coord,
-                                                getIsVolume(),
-                                                &anOrigin));
-          if(periodicVoxel != NULL && 
-             periodicVoxel->id == theVacantID)
+          for(std::vector<Voxel*>::const_iterator j(
+              theBoundaryMolecules[i].begin());
+              j != theBoundaryMolecules[i].end(); ++j)
             {
-              theMolecules[i]->id = theVacantID;
-              theMolecules[i] = periodicVoxel;
-              theMolecules[i]->id = theID;
-              theMoleculeOrigins[i] = anOrigin;
+              if(theStepper->getID(*j) != theID)
+                {
+                  continue;
+                }
+              const unsigned int anIndex(theStepper->getMoleculeIndex(*j));
+              if(anIndex < theMolecules.size() && theMolecules[anIndex] == *j &&
+                 !relocateBoundaryMolecule(anIndex))
+                {
+                  aPendingMolecules.push_back(*j);
+                }
             }
+          theBoundaryMolecules[i].clear();
+        }
+      //A molecule can be reported more than once:
+      std::sort(aPendingMolecules.begin(), aPendingMolecules.end());
+      aPendingMolecules.erase(std::unique(aPendingMolecules.begin(),
+                                          aPendingMolecules.end()),
+                              aPendingMolecules.end());
+      theBoundaryMolecules[0].swap(aPendingMolecules);
+    }
+  //Returns false if the molecule at anIndex is on a periodic boundary but
+  //its periodic voxel is occupied:
+  bool relocateBoundaryMolecule(unsigned int anIndex)
+    {
+      Voxel* aMolecule(theMolecules[anIndex]);
+      Voxel* periodicVoxel(theStepper->getPeriodicVoxel(aMolecule->coord,
+                                                        getIsVolume()));
+      if(periodicVoxel == NULL)
+        {
+          return true;
         }
+      if(theStepper->getID(periodicVoxel) != theVacantID)
+        {
+          return false;
+        }
+      theStepper->setID(aMolecule, theVacantID);
+      theStepper->setID(periodicVoxel, theID);
+      //The molecule list of a diffuse vacant species is updated by setID.
+      //The displacement is unchanged since periodicVoxel is an image of
+      //the voxel:
+      if(!getIsDiffuseVacant())
+        {
+          setMolecule(anIndex, periodicVoxel);
+        }
+      return true;
     }
   int getVacantID() const
     {
@@ -711,6 +1064,11 @@ public:
         {
           *i = (*i)*aWalkProbability;
         }
+      for(unsigned int i(0); i != theReactionProbabilities.size(); ++i)
+        {
+          theCollisionRow[i].cutoff =
+            getCollisionCutoff(theReactionProbabilities[i]);
+        }
     }
   void setDiffusionInterval(double anInterval)
     {
@@ -724,7 +1082,7 @@ public:
           std::cout << "Species size error:" <<
             theVariable->getValue() << std::endl;
         }
-      return theMolecules[gsl_rng_uniform_int(theRng, theMoleculeSize)];
+      return theMolecules[theRandom.uniformInt(theMoleculeSize)];
     }
   void addInterruptedProcess(SpatiocyteProcessInterface* aProcess)
     {
@@ -743,99 +1101,92 @@ public:
     }
   Voxel* getRandomAdjoiningVoxel(Voxel* source)
     {
-      std::vector<Voxel*> CompVoxels;
-      if(theStepper->getSearchVacant())
-        { 
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
-            {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(aVoxel->id == theVacantID)
-                {
-                  CompVoxels.push_back(aVoxel);
-                }
-            }
-        }
-      else
-        {
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
-            {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(theStepper->id2Comp(aVoxel->id) == theComp)
-                {
-                  CompVoxels.push_back(aVoxel);
-                }
-            }
-        }
-      return getRandomVacantVoxel(&CompVoxels);
+      return getRandomAdjoiningVoxel(source, theVacantID, NULL, NULL);
     } 
   Voxel* getRandomAdjoiningVoxel(Voxel* source, Species* aVacantSpecies)
     {
-      std::vector<Voxel*> CompVoxels;
-      if(theStepper->getSearchVacant())
-        { 
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
+      return getRandomAdjoiningVoxel(source, aVacantSpecies->getID(), NULL,
+                                     NULL);
+    } 
+  Voxel* getRandomAdjoiningVoxel(Voxel* source, Voxel* target)
+    {
+      return getRandomAdjoiningVoxel(source, theVacantID, target, NULL);
+    }
+  Voxel* getRandomAdjoiningVoxel(Voxel* source, Voxel* targetA, Voxel* targetB)
+    {
+      return getRandomAdjoiningVoxel(source, theVacantID, targetA, targetB);
+    }
+  Voxel* getRandomCompVoxel()
+    {
+      //Pick directly from the vacant voxels of the Comp. Without
+      //SearchVacant, a random voxel of the Comp is only accepted if it is
+      //vacant, so we keep the same acceptance probability:
+      if(theVacantID == theComp->vacantID)
+        {
+          const std::vector<Voxel*>& aVacantVoxels(theComp->vacantVoxels);
+          if(aVacantVoxels.empty() || (!theStepper->getSearchVacant() &&
+             theRandom.uniformInt(theComp->coords.size()) >= 
+             aVacantVoxels.size()))
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(aVoxel->id == aVacantSpecies->getID())
-                {
-                  CompVoxels.push_back(aVoxel);
-                }
+              return NULL;
             }
+          return aVacantVoxels[theRandom.uniformInt(aVacantVoxels.size())];
         }
-      else
+      int aSize(theComp->coords.size());
+      int r(theRandom.uniformInt(aSize));
+      if(theStepper->getSearchVacant())
         {
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
+          for(int i(r); i != aSize; ++i)
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(theStepper->id2Comp(aVoxel->id) == theComp)
+              Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[i]));
+              if(theStepper->getID(aVoxel) == theVacantID)
                 {
-                  CompVoxels.push_back(aVoxel);
+                  return aVoxel;
                 }
             }
-        }
-      return getRandomVacantVoxel(&CompVoxels, aVacantSpecies);
-    } 
-  Voxel* getRandomAdjoiningVoxel(Voxel* source, Voxel* target)
-    {
-      std::vector<Voxel*> CompVoxels;
-      if(theStepper->getSearchVacant())
-        { 
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
+          for(int i(0); i != r; ++i)
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(aVoxel->id == theVacantID &&
-                 aVoxel != target)
+              Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[i]));
+              if(theStepper->getID(aVoxel) == theVacantID)
                 {
-                  CompVoxels.push_back(aVoxel);
+                  return aVoxel;
                 }
             }
         }
       else
         {
-          for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
+          Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[r]));
+          if(theStepper->getID(aVoxel) == theVacantID)
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(theStepper->id2Comp(aVoxel->id) == theComp &&
-                 aVoxel != target)
-                {
-                  CompVoxels.push_back(aVoxel);
-                }
+              return aVoxel;
             }
         }
-      return getRandomVacantVoxel(&CompVoxels);
+      return NULL;
     }
-  Voxel* getRandomAdjoiningVoxel(Voxel* source, Voxel* targetA, Voxel* targetB)
+  Voxel* getRandomAdjoiningCompVoxel(Comp* aComp)
+    {
+      int aSize(aComp->coords.size());
+      int r(theRandom.uniformInt(aSize)); 
+      Voxel* aVoxel(theStepper->coord2voxel(aComp->coords[r]));
+      return getRandomAdjoiningVoxel(aVoxel);
+    }
+private:
+  //The candidate voxels are collected in a stack array instead of a
+  //std::vector since this is called for every product of a reaction:
+  Voxel* getRandomAdjoiningVoxel(Voxel* source, unsigned short aVacantID,
+                                 Voxel* targetA, Voxel* targetB)
     {
-      std::vector<Voxel*> CompVoxels;
+      Voxel* compVoxels[MAX_ADJOINING_VOXEL_SIZE];
+      unsigned int aSize(0);
       if(theStepper->getSearchVacant())
         { 
           for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(aVoxel->id == theVacantID &&
+              Voxel* aVoxel(theStepper->getAdjoiningVoxel(source, i));
+              if(theStepper->getID(aVoxel) == aVacantID &&
                  aVoxel != targetA && aVoxel != targetB)
                 {
-                  CompVoxels.push_back(aVoxel);
+                  compVoxels[aSize++] = aVoxel;
                 }
             }
         }
@@ -843,84 +1194,104 @@ public:
         {
           for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
             {
-              Voxel* aVoxel(source->adjoiningVoxels[i]);
-              if(theStepper->id2Comp(aVoxel->id) == theComp &&
+              Voxel* aVoxel(theStepper->getAdjoiningVoxel(source, i));
+              if(theStepper->id2Comp(theStepper->getID(aVoxel)) == theComp &&
                  aVoxel != targetA && aVoxel != targetB)
                 {
-                  CompVoxels.push_back(aVoxel);
+                  compVoxels[aSize++] = aVoxel;
                 }
             }
         }
-      return getRandomVacantVoxel(&CompVoxels);
-    }
-  Voxel* getRandomVacantVoxel(std::vector<Voxel*>* voxels)
-    {
-      if(voxels->size())
+      if(aSize)
         {
-          const int r(gsl_rng_uniform_int(theRng, voxels->size())); 
-          Voxel* aVoxel((*voxels)[r]);
-          if(aVoxel->id == theVacantID)
+          Voxel* aVoxel(compVoxels[theRandom.uniformInt(aSize)]);
+          if(theStepper->getID(aVoxel) == aVacantID)
             {
               return aVoxel;
             }
         }
       return NULL;
     }
-  Voxel* getRandomVacantVoxel(std::vector<Voxel*>* voxels,
-                              Species* aVacantSpecies)
+  void initDisplacement(unsigned int anIndex)
     {
-      if(voxels->size())
+      if(isDisplacementTracked)
         {
-          const int r(gsl_rng_uniform_int(theRng, voxels->size())); 
-          Voxel* aVoxel((*voxels)[r]);
-          if(aVoxel->id == aVacantSpecies->getID())
+          if(anIndex >= theDisplacements.size())
             {
-              return aVoxel;
+              theDisplacements.resize(anIndex+1);
             }
+          theStepper->initDisplacement(theMolecules[anIndex],
+                                       theDisplacements[anIndex]);
         }
-      return NULL;
     }
-  Voxel* getRandomCompVoxel()
+  //The displacement of a soft removed molecule is swapped to the end of the
+  //list so that restoreMolecule can swap it back:
+  void swapDisplacements(unsigned int anIndex, unsigned int anotherIndex)
     {
-      int aSize(theComp->coords.size());
-      int r(gsl_rng_uniform_int(theRng, aSize));
-      if(theStepper->getSearchVacant())
+      if(isDisplacementTracked)
         {
-          for(int i(r); i != aSize; ++i)
-            {
-              Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[i]));
-              if(aVoxel->id == theVacantID)
-                {
-                  return aVoxel;
-                }
-            }
-          for(int i(0); i != r; ++i)
-            {
-              Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[i]));
-              if(aVoxel->id == theVacantID)
-                {
-                  return aVoxel;
-                }
-            }
+          std::swap(theDisplacements[anIndex], theDisplacements[anotherIndex]);
         }
-      else
+    }
+  Displacement getDisplacement(unsigned int anIndex) const
+    {
+      if(isDisplacementTracked && anIndex < theDisplacements.size())
         {
-          Voxel* aVoxel(theStepper->coord2voxel(theComp->coords[r]));
-          if(aVoxel->id == theVacantID)
+          return theDisplacements[anIndex];
+        }
+      return Displacement();
+    }
+  //A product of this species at the voxel of a reacted molecule of this
+  //species continues the displacement of the reactant:
+  void carryDisplacement(Voxel* aMolecule, const Displacement& aDisplacement)
+    {
+      if(isDisplacementTracked && theStepper->getID(aMolecule) == theID)
+        {
+          const unsigned int i(theStepper->getMoleculeIndex(aMolecule));
+          if(i < theMoleculeSize && theMolecules[i] == aMolecule)
             {
-              return aVoxel;
+              theDisplacements[i] = aDisplacement;
             }
         }
-      return NULL;
     }
-  Voxel* getRandomAdjoiningCompVoxel(Comp* aComp)
+  //Reports a molecule that may have moved onto a periodic boundary. Each
+  //thread of the walk has its own list:
+  void addBoundaryMolecule(Voxel* aMolecule, unsigned int aThread)
     {
-      int aSize(aComp->coords.size());
-      int r(gsl_rng_uniform_int(theRng, aSize)); 
-      Voxel* aVoxel(theStepper->coord2voxel(aComp->coords[r]));
-      return getRandomAdjoiningVoxel(aVoxel);
+      if(isPeriodic && theStepper->isBoundaryVoxel(aMolecule, isVolume))
+        {
+          theBoundaryMolecules[aThread].push_back(aMolecule);
+        }
+    }
+  //The cutoff is rounded up so that comparing a random integer k with it
+  //is the same as comparing k/2^32 with the probability. A probability of
+  //1 or more gives 2^32, which is above every random integer:
+  static uint64_t getCollisionCutoff(double aProbability)
+    {
+      if(aProbability >= 1)
+        {
+          return 4294967296ULL;
+        }
+      if(aProbability <= 0)
+        {
+          return 0;
+        }
+      return static_cast<uint64_t>(ceil(aProbability*4294967296.0));
+    }
+  //Every change to theMolecules must go through here to keep the molecule
+  //index of the voxel, used for constant time removal, up to date:
+  void setMolecule(unsigned int anIndex, Voxel* aMolecule)
+    {
+      if(anIndex == theMolecules.size())
+        {
+          theMolecules.push_back(aMolecule);
+        }
+      else
+        {
+          theMolecules[anIndex] = aMolecule;
+        }
+      theStepper->setMoleculeIndex(aMolecule, anIndex);
     }
-private:
   bool isDiffuseVacant;
   bool isVacant;
   bool isVolume;
@@ -928,33 +1299,39 @@ private:
   bool isDiffusing;
   bool isGaussianPopulation;
   bool isInContact;
+  bool isDisplacementTracked;
+  bool isPeriodic;
   bool isPolymer;
   bool isStatic;
   bool isSubunitInitialized;
   const unsigned short theID;
   const unsigned int theInitMoleculeSize;
   unsigned int theMoleculeSize;
+  unsigned int theWalkCount;
   unsigned int theAdjoiningVoxelSize;
   int thePolymerDirectionality;
   int theVacantID;
   double D;
   double theDiffusionInterval;
   double theWalkProbability;
-  const gsl_rng* theRng;
   Species* theVacantSpecies;
   Comp* theComp;
   MoleculePopulateProcessInterface* thePopulateProcess;
   SpatiocyteStepper* theStepper;
   Variable* theVariable;
+  CollisionEntry* theCollisionRow;
   std::vector<bool> theFinalizeReactions;
   std::vector<double> theBendAngles;
   std::vector<double> theReactionProbabilities;
   std::vector<Voxel*> theMolecules;
   std::vector<Species*> theDiffusionInfluencedReactantPairs;
-  std::vector<DiffusionInfluencedReactionProcessInterface*> 
-    theDiffusionInfluencedReactions;
   std::vector<SpatiocyteProcessInterface*> theInterruptedProcesses;
-  std::vector<Origin> theMoleculeOrigins;
+  std::vector<Displacement> theDisplacements;
+  std::vector<std::vector<Voxel*> > theBoundaryMolecules;
+  std::vector<std::vector<unsigned int> > theSectorMolecules;
+  std::vector<std::vector<Collision> > theCollisions;
+  RandomBuffer theRandom;
+  std::vector<RandomBuffer> theThreadRandoms;
 };
 
 
@@ -30,6 +30,15 @@
 
 
 #include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <gsl/gsl_randist.h>
 #include <libecs/Model.hpp>
 #include <libecs/System.hpp>
@@ -38,9 +47,22 @@
 #include "SpatiocyteSpecies.hpp"
 #include "SpatiocyteProcessInterface.hpp"
 #include "ReactionProcessInterface.hpp"
+#include "ReactionGroup.hpp"
+#include "TauLeapGroup.hpp"
+#include "DiffusionGroup.hpp"
+#include "DiffusionProcessInterface.hpp"
 
 LIBECS_DM_INIT(SpatiocyteStepper, Stepper);
 
+SpatiocyteStepper::~SpatiocyteStepper()
+{
+  finalizeThreads();
+  delete theReactionGroup;
+  delete theTauLeapGroup;
+  delete[] theLoadedAdjoiningVoxels;
+  clearDiffusionGroups();
+}
+
 void SpatiocyteStepper::initialize()
 {
   if(isInitialized)
@@ -60,25 +82,58 @@ void SpatiocyteStepper::initialize()
   //and get the available number of vacant voxels. The compartmentalized
   //vacant voxels are needed to randomly place molecules according to the
   //Comp:
+  double aTime(getWallTime());
   std::cout << "1. creating compartments..." << std::endl;
   registerComps();
   setCompsProperties();
+  addInitTime("creating compartments", &aTime);
   std::cout << "2. setting up lattice properties..." << std::endl;
   setLatticeProperties(); 
   setCompsCenterPoint();
+  initThreads();
+  addInitTime("setting up lattice properties", &aTime);
   //All species have been created at this point, we initialize them now:
   std::cout << "3. initializing species..." << std::endl;
   initSpecies();
+  addInitTime("initializing species", &aTime);
   std::cout << "4. initializing processes the second time..." << std::endl;
   initProcessSecond();
+  addInitTime("initializing processes the second time", &aTime);
   std::cout << "5. constructing lattice..." << std::endl;
-  constructLattice();
+  //A lattice file saved by an earlier run with the same geometry lets us
+  //skip the construction and compartmentalization of the lattice:
+  const bool isLoaded(loadLattice());
+  if(!isLoaded)
+    {
+      constructLattice();
+    }
+  addInitTime(isLoaded ? "loading lattice" : "constructing lattice", &aTime);
   std::cout << "6. setting intersecting compartment list..." << std::endl;
   setIntersectingCompartmentList();
+  addInitTime("setting intersecting compartment list", &aTime);
   std::cout << "7. compartmentalizing lattice..." << std::endl;
-  compartmentalizeLattice();
+  if(!isLoaded)
+    {
+      compartmentalizeLattice();
+      addInitTime("compartmentalizing lattice", &aTime);
+    }
   std::cout << "8. setting up compartment voxels properties..." << std::endl;
-  setCompVoxelProperties();
+  if(isLoaded)
+    {
+      setLoadedCompVoxelProperties();
+      addInitTime("setting up compartment voxels properties", &aTime);
+    }
+  else
+    {
+      setCompVoxelProperties();
+      addInitTime("setting up compartment voxels properties", &aTime);
+      saveLattice();
+      addInitTime("saving lattice", &aTime);
+    }
+  if(isPeriodicEdge)
+    {
+      setBoundaryFlags();
+    }
   std::cout << "9. printing simulation parameters..." << std::endl;
   storeSimulationParameters();
   printSimulationParameters();
@@ -136,6 +191,13 @@ double SpatiocyteStepper::getNormalizedVoxelRadius()
 void SpatiocyteStepper::reset(int seed)
 {
   gsl_rng_set(getRng(), seed); 
+  setThreadRngs(seed);
+  theRandomSeed = seed;
+  for(std::vector<Species*>::iterator i(theSpecies.begin());
+      i != theSpecies.end(); ++i)
+    {
+      (*i)->initRandoms();
+    }
   setCurrentTime(0);
   initProcessSecond();
   clearComps();
@@ -146,13 +208,173 @@ void SpatiocyteStepper::reset(int seed)
   //checkLattice();
 }
 
+void SpatiocyteStepper::initThreads()
+{
+  //Each thread walks two sectors that are at least MIN_SECTOR_COL_SIZE
+  //columns wide, so reduce the number of threads for small lattices:
+  if(ThreadSize > 1 && theColSize/(ThreadSize*2) < MIN_SECTOR_COL_SIZE)
+    {
+      unsigned int aThreadSize(std::max(theColSize/(MIN_SECTOR_COL_SIZE*2),
+                                         1U));
+      std::cout << "   The lattice only has " << theColSize << 
+        " columns, reducing ThreadSize from " << ThreadSize << " to " <<
+        aThreadSize << std::endl;
+      ThreadSize = aThreadSize;
+    }
+  if(ThreadSize <= 1)
+    {
+      ThreadSize = 1;
+      return;
+    }
+  const unsigned int aSectorSize(ThreadSize*2);
+  theColSectors.resize(theColSize);
+  for(unsigned int i(0); i != theColSize; ++i)
+    {
+      theColSectors[i] = i*aSectorSize/theColSize;
+    }
+  //Each thread has its own random number stream:
+  for(unsigned int i(0); i != ThreadSize; ++i)
+    {
+      theThreadRngs.push_back(gsl_rng_clone(getRng()));
+    }
+  setThreadRngs(gsl_rng_get(getRng()));
+  pthread_barrier_init(&theThreadBarrier, NULL, ThreadSize);
+  //The current thread is also used as the first thread:
+  theThreads.resize(ThreadSize-1);
+  for(unsigned int i(1); i != ThreadSize; ++i)
+    {
+      std::pair<SpatiocyteStepper*, unsigned int>* anArgument(
+                 new std::pair<SpatiocyteStepper*, unsigned int>(this, i));
+      if(pthread_create(&theThreads[i-1], NULL,
+                        &SpatiocyteStepper::runThread, anArgument))
+        {
+          THROW_EXCEPTION(InitializationFailed,
+                          getPropertyInterface().getClassName() + 
+                          ": unable to create the walk threads.");
+        }
+    }
+}
+
+//The random stream of a species in the serial walk and processes is
+//aThread = 0, while walk thread i uses aThread = i+1:
+void SpatiocyteStepper::initRandom(RandomBuffer& aBuffer, unsigned int aStream,
+                                   unsigned int aThread)
+{
+  if(RandomEngine == PHILOX_RANDOM)
+    {
+      aBuffer.setPhiloxEngine(theRandomSeed, aStream, aThread);
+    }
+  else if(aThread)
+    {
+      aBuffer.setGslEngine(theThreadRngs[aThread-1]);
+    }
+  else
+    {
+      aBuffer.setGslEngine(getRng());
+    }
+}
+
+void SpatiocyteStepper::setThreadRngs(unsigned long int aSeed)
+{
+  for(unsigned int i(0); i != theThreadRngs.size(); ++i)
+    {
+      gsl_rng_set(theThreadRngs[i], aSeed+i+1);
+    }
+}
+
+void SpatiocyteStepper::finalizeThreads()
+{
+  if(theThreads.empty())
+    {
+      return;
+    }
+  //A NULL task tells the threads to exit:
+  theThreadTask = NULL;
+  pthread_barrier_wait(&theThreadBarrier);
+  for(unsigned int i(0); i != theThreads.size(); ++i)
+    {
+      pthread_join(theThreads[i], NULL);
+    }
+  theThreads.clear();
+  pthread_barrier_destroy(&theThreadBarrier);
+  for(unsigned int i(0); i != theThreadRngs.size(); ++i)
+    {
+      gsl_rng_free(theThreadRngs[i]);
+    }
+  theThreadRngs.clear();
+}
+
+void* SpatiocyteStepper::runThread(void* anArgument)
+{
+  std::pair<SpatiocyteStepper*, unsigned int>* aPair(
+     static_cast<std::pair<SpatiocyteStepper*, unsigned int>*>(anArgument));
+  SpatiocyteStepper* aStepper(aPair->first);
+  const unsigned int aThread(aPair->second);
+  delete aPair;
+  while(true)
+    {
+      //Wait for a task from runThreads:
+      pthread_barrier_wait(&aStepper->theThreadBarrier);
+      if(aStepper->theThreadTask == NULL)
+        {
+          break;
+        }
+      aStepper->theThreadTask(aStepper->theThreadArgument, aThread);
+      //Tell runThreads that the task is complete:
+      pthread_barrier_wait(&aStepper->theThreadBarrier);
+    }
+  return NULL;
+}
+
+//Execute aTask(anArgument, thread) in all threads, including the current
+//thread as the first thread, and return when all of them are complete:
+void SpatiocyteStepper::runThreads(ThreadTask aTask, void* anArgument)
+{
+  if(theThreads.empty())
+    {
+      aTask(anArgument, 0);
+      return;
+    }
+  theThreadTask = aTask;
+  theThreadArgument = anArgument;
+  pthread_barrier_wait(&theThreadBarrier);
+  aTask(anArgument, 0);
+  pthread_barrier_wait(&theThreadBarrier);
+}
+
+//Called by all threads within a task to wait until every thread reaches
+//the same point, e.g., between the two sector phases of a walk:
+void SpatiocyteStepper::waitThreads()
+{
+  if(!theThreads.empty())
+    {
+      pthread_barrier_wait(&theThreadBarrier);
+    }
+}
+
+double SpatiocyteStepper::getWallTime()
+{
+  struct timespec aTime;
+  clock_gettime(CLOCK_MONOTONIC, &aTime);
+  return aTime.tv_sec+aTime.tv_nsec*1e-9;
+}
+
+//Stores the wall time elapsed since aStartTime as the time of the
+//initialization phase aPhase, and restarts aStartTime for the next phase:
+void SpatiocyteStepper::addInitTime(String const& aPhase, double* aStartTime)
+{
+  const double aTime(getWallTime());
+  theInitTimes.push_back(std::make_pair(aPhase, aTime-*aStartTime));
+  *aStartTime = aTime;
+}
+
 Species* SpatiocyteStepper::addSpecies(Variable* aVariable)
 {
   std::vector<Species*>::iterator aSpeciesIter(variable2ispecies(aVariable));
   if(aSpeciesIter == theSpecies.end())
     {
       Species *aSpecies(new Species(this, aVariable, theSpecies.size(),
-                                    (int)aVariable->getValue(), getRng()));
+                                    (int)aVariable->getValue()));
       theSpecies.push_back(aSpecies);
       return aSpecies;
     }
@@ -215,8 +437,7 @@ bool SpatiocyteStepper::isBoundaryCoord(unsigned int aCoord, bool isVolume)
 }
 
 Voxel* SpatiocyteStepper::getPeriodicVoxel(unsigned int aCoord,
-                                           bool isVolume,
-                                           Origin* anOrigin)
+                                           bool isVolume)
 {
   //This method is only for checking boundaries on a cube:
   unsigned int aRow;
@@ -234,79 +455,68 @@ Voxel* SpatiocyteStepper::getPeriodicVoxel(unsigned int aCoord,
   if(aRow == 1+adj)
     {
       nextRow = theRowSize-(3+adj);
-      --anOrigin->row;
     }
   else if(aRow == theRowSize-(2+adj))
     {
       nextRow = 2+adj;
-      ++anOrigin->row;
     }
   if(aLayer == 1+adj)
     {
       nextLayer = theLayerSize-(3+adj);
-      --anOrigin->layer;
     }
   else if(aLayer == theLayerSize-(2+adj))
     {
       nextLayer = 2+adj;
-      ++anOrigin->layer;
     }
   if(aCol == 1+adj)
     {
       nextCol = theColSize-(3+adj);
-      --anOrigin->col;
     }
   else if(aCol == theColSize-(2+adj))
     {
       nextCol = 2+adj;
-      ++anOrigin->col;
     }
   if(nextRow != aRow || nextCol != aCol || nextLayer != aLayer)
     {
-      return &theLattice[nextRow+
-                         theRowSize*nextLayer+
-                         theRowSize*theLayerSize*nextCol];
+      return &theLattice[global2index(nextRow, nextLayer, nextCol)];
     }
   return NULL;
 }
 
-Point SpatiocyteStepper::getPeriodicPoint(unsigned int aCoord,
-                                          bool isVolume,
-                                          Origin* anOrigin)
+//The unwrapped global coordinates can be outside the lattice or negative,
+//so the parities are taken with & 1:
+Point SpatiocyteStepper::global2point(int aGlobalRow, int aGlobalLayer,
+                                      int aGlobalCol)
 {
-  unsigned int adj(1);
-  if(isVolume)
-    {
-      adj = 0;
-    }
-  unsigned int row(theRowSize-(3+adj)-(1+adj));
-  unsigned int layer(theLayerSize-(3+adj)-(1+adj));
-  unsigned int col(theColSize-(3+adj)-(1+adj));
-  unsigned int aGlobalCol;
-  unsigned int aGlobalLayer;
-  unsigned int aGlobalRow;
-  coord2global(aCoord, &aGlobalRow, &aGlobalLayer, &aGlobalCol);
-  int aRow(aGlobalRow+anOrigin->row*row);
-  int aLayer(aGlobalLayer+anOrigin->layer*layer);
-  int aCol(aGlobalCol+anOrigin->col*col);
   Point aPoint;
   switch(LatticeType)
     {
     case HCP_LATTICE: 
-      aPoint.y = (aCol%2)*theHCPk+theHCPl*aLayer;
-      aPoint.z = aRow*2*theNormalizedVoxelRadius+
-        ((aLayer+aCol)%2)*theNormalizedVoxelRadius;
-      aPoint.x = aCol*theHCPh;
+      aPoint.y = (aGlobalCol & 1)*theHCPk+theHCPl*aGlobalLayer;
+      aPoint.z = aGlobalRow*2*theNormalizedVoxelRadius+
+        ((aGlobalLayer+aGlobalCol) & 1)*theNormalizedVoxelRadius;
+      aPoint.x = aGlobalCol*theHCPh;
       break;
     case CUBIC_LATTICE:
-      aPoint.y = aLayer*2*theNormalizedVoxelRadius;
-      aPoint.z = aRow*2*theNormalizedVoxelRadius;
-      aPoint.x = aCol*2*theNormalizedVoxelRadius;
+      aPoint.y = aGlobalLayer*2*theNormalizedVoxelRadius;
+      aPoint.z = aGlobalRow*2*theNormalizedVoxelRadius;
+      aPoint.x = aGlobalCol*2*theNormalizedVoxelRadius;
       break;
     }
   return aPoint;
 }
 
+void SpatiocyteStepper::initDisplacement(const Voxel* aVoxel,
+                                         Displacement& aDisplacement)
+{
+  unsigned int aGlobalRow;
+  unsigned int aGlobalLayer;
+  unsigned int aGlobalCol;
+  coord2global(aVoxel->coord, &aGlobalRow, &aGlobalLayer, &aGlobalCol);
+  aDisplacement.originRow = aDisplacement.row = aGlobalRow;
+  aDisplacement.originLayer = aDisplacement.layer = aGlobalLayer;
+  aDisplacement.originCol = aDisplacement.col = aGlobalCol;
+}
 
 std::vector<Species*>::iterator
 SpatiocyteStepper::variable2ispecies(Variable* aVariable)
@@ -344,7 +554,7 @@ void SpatiocyteStepper::checkLattice()
     }
   for(unsigned int i(0); i!=theLattice.size(); ++i)
     {
-      ++list[theLattice[i].id];
+      ++list[getID(&theLattice[i])];
     }
   int volumeCnt(0);
   int surfaceCnt(0);
@@ -372,6 +582,25 @@ void SpatiocyteStepper::checkLattice()
 
 void SpatiocyteStepper::initSpecies()
 {
+  if(RandomEngine != GSL_RANDOM && RandomEngine != PHILOX_RANDOM)
+    {
+      THROW_EXCEPTION(ValueError, getPropertyInterface().getClassName() + 
+                      ": RandomEngine must be 0 (GSL) or 1 (Philox).");
+    }
+  //The Philox key is only drawn when it is used, since the draw advances
+  //the shared stream that the GSL_RANDOM mode must reproduce:
+  if(RandomEngine == PHILOX_RANDOM)
+    {
+      theRandomSeed = gsl_rng_get(getRng());
+    }
+  //Vacant voxels are only tracked after the lattice is compartmentalized:
+  theVacantComps.assign(theSpecies.size(), NULL);
+  theVoxelLists.assign(theSpecies.size(), NULL);
+  //The rows of the collision table are handed out to the species, so it
+  //must not be resized afterwards:
+  CollisionEntry anEmptyEntry = {NULL, 0};
+  theCollisionTable.assign(theSpecies.size()*theSpecies.size(),
+                           anEmptyEntry);
   for(std::vector<Species*>::iterator i(theSpecies.begin());
       i != theSpecies.end(); ++i)
     {
@@ -399,6 +628,19 @@ void SpatiocyteStepper::printProcessParameters()
         aProcess(dynamic_cast<SpatiocyteProcessInterface*>(*i));
       aProcess->printParameters();
     }
+  if(theReactionGroup)
+    {
+      theReactionGroup->printParameters();
+    }
+  if(theTauLeapGroup)
+    {
+      theTauLeapGroup->printParameters();
+    }
+  for(std::vector<DiffusionGroup*>::iterator i(theDiffusionGroups.begin());
+      i != theDiffusionGroups.end(); ++i)
+    {
+      (*i)->printParameters();
+    }
   std::cout << std::endl;
 }
 
@@ -436,10 +678,112 @@ void SpatiocyteStepper::initProcessLastOnce()
     }
 }
 
+//A process can only interrupt the processes that access a variable it
+//references. So instead of testing every pair of processes, every process
+//is indexed under the variables it accesses, and each process that can
+//interrupt others only tests the processes indexed under its own
+//variables, in the order of theProcessVector:
+void SpatiocyteStepper::setInterrupts()
+{
+  theInterrupts.clear();
+  std::map<Variable*, std::vector<unsigned int> > anAccessors;
+  for(unsigned int i(0); i != theProcessVector.size(); ++i)
+    {
+      VariableReferenceVector const& aVariableReferences(
+                     theProcessVector[i]->getVariableReferenceVector());
+      for(VariableReferenceVector::const_iterator j(
+          aVariableReferences.begin()); j != aVariableReferences.end(); ++j)
+        {
+          if(j->isAccessor())
+            {
+              std::vector<unsigned int>& aProcesses(
+                                      anAccessors[j->getVariable()]);
+              if(aProcesses.empty() || aProcesses.back() != i)
+                {
+                  aProcesses.push_back(i);
+                }
+            }
+        }
+    }
+  for(unsigned int i(0); i != theProcessVector.size(); ++i)
+    {
+      //The following processes never interrupt other Processes.
+      //We exclude them here and set up the interrupt for the remaining
+      //processes. All processes which interrupt other processes have
+      //the ReactionProcess as the base class.
+      ReactionProcessInterface* aReactionProcess(
+              dynamic_cast<ReactionProcessInterface*>(theProcessVector[i]));
+      if(aReactionProcess == NULL)
+        {
+          continue;
+        }
+      std::vector<unsigned int> aCandidates;
+      VariableReferenceVector const& aVariableReferences(
+                     theProcessVector[i]->getVariableReferenceVector());
+      for(VariableReferenceVector::const_iterator j(
+          aVariableReferences.begin()); j != aVariableReferences.end(); ++j)
+        {
+          std::map<Variable*, std::vector<unsigned int> >::const_iterator
+            anIter(anAccessors.find(j->getVariable()));
+          if(anIter != anAccessors.end())
+            {
+              aCandidates.insert(aCandidates.end(), anIter->second.begin(),
+                                 anIter->second.end());
+            }
+        }
+      std::sort(aCandidates.begin(), aCandidates.end());
+      aCandidates.erase(std::unique(aCandidates.begin(), aCandidates.end()),
+                        aCandidates.end());
+      std::vector<Process*> aProcessList;
+      for(std::vector<unsigned int>::const_iterator j(aCandidates.begin());
+          j != aCandidates.end(); ++j)
+        {
+          aProcessList.push_back(theProcessVector[*j]);
+        }
+      aReactionProcess->setInterrupt(aProcessList, theProcessVector[i]);
+    }
+}
+
+//The stamp is advanced so that the notified processes can be added again
+//by the next batch of reactions:
+void SpatiocyteStepper::notifyInterrupts()
+{
+  const Time aCurrentTime(getCurrentTime());
+  for(std::vector<SpatiocyteProcessInterface*>::const_iterator
+      i(theInterrupts.begin()); i != theInterrupts.end(); ++i)
+    {
+      (*i)->substrateValueChanged(aCurrentTime);
+    }
+  theInterrupts.clear();
+  ++theInterruptStamp;
+}
+
 void SpatiocyteStepper::initPriorityQueue()
 {
   const double aCurrentTime(getCurrentTime());
   thePriorityQueue.clear();
+  delete theReactionGroup;
+  theReactionGroup = NULL;
+  if(GroupReactions)
+    {
+      theReactionGroup = new ReactionGroup(getRng());
+    }
+  delete theTauLeapGroup;
+  theTauLeapGroup = NULL;
+  if(TauLeap > 0)
+    {
+      theTauLeapGroup = new TauLeapGroup(getRng(), TauLeap);
+    }
+  clearDiffusionGroups();
+  //With GroupDiffusion, the DiffusionProcesses are first collected by
+  //their diffusion intervals:
+  std::vector<double> aGroupIntervals;
+  std::vector<std::vector<DiffusionProcessInterface*> > aGroupProcesses;
+  if(!thePriorityQueue.setArity(QueueArity))
+    {
+      THROW_EXCEPTION(ValueError, getPropertyInterface().getClassName() + 
+                      ": QueueArity must be 2, 4 or 8.");
+    }
   for(std::vector<Process*>::const_iterator i(theProcessVector.begin());
       i != theProcessVector.end(); ++i)
     {      
@@ -467,21 +811,101 @@ void SpatiocyteStepper::initPriorityQueue()
              aClassName == "SpatiocyteNextReactionProcess" ||
              aClassName == "PolymerFragmentationProcess")
             {
-              aSpatiocyteProcess->setQueueID(
+              //With GroupReactions, all SpatiocyteNextReactionProcesses
+              //share the single queue entry of theReactionGroup:
+              SpatiocyteNextReactionProcessInterface* aReaction(
+                dynamic_cast<SpatiocyteNextReactionProcessInterface*>(*i));
+              if(aReaction)
+                {
+                  //Detach from the group of a previous run:
+                  aReaction->setReactionGroup(NULL, 0);
+                  aReaction->setTauLeapGroup(NULL, 0);
+                }
+              DiffusionProcessInterface* aDiffusion(
+                dynamic_cast<DiffusionProcessInterface*>(*i));
+              if(aDiffusion)
+                {
+                  aDiffusion->setDiffusionGroup(NULL);
+                }
+              //With TauLeap, the reactions of only HD variables are
+              //leaped together by theTauLeapGroup:
+              if(theTauLeapGroup && aReaction && aReaction->isHDReaction())
+                {
+                  theTauLeapGroup->addReaction(aReaction, aProcess);
+                }
+              else if(theReactionGroup && aReaction &&
+                      !aReaction->getIsBatch())
+                {
+                  theReactionGroup->addReaction(aReaction);
+                }
+              else if(GroupDiffusion && aDiffusion &&
+                      aDiffusion->getIsGroupable())
+                {
+                  const double anInterval(aDiffusion->getDiffusionSpecies(
+                                                 )->getDiffusionInterval());
+                  const unsigned int aGroup(std::find(aGroupIntervals.begin(),
+                      aGroupIntervals.end(), anInterval)-
+                      aGroupIntervals.begin());
+                  if(aGroup == aGroupIntervals.size())
+                    {
+                      aGroupIntervals.push_back(anInterval);
+                      aGroupProcesses.resize(aGroup+1);
+                    }
+                  aGroupProcesses[aGroup].push_back(aDiffusion);
+                }
+              else
+                {
+                  aSpatiocyteProcess->setQueueID(
                                    thePriorityQueue.push(aSpatiocyteProcess));
+                }
             }
         }
-      //The following processes never interrupt other Processes.
-      //We exclude them here and set up the interrupt for the remaining
-      //processes. All processes which interrupt other processes have
-      //the ReactionProcess as the base class.
-      ReactionProcessInterface*
-        aReactionProcess(dynamic_cast<ReactionProcessInterface*>(*i));
-      if(aReactionProcess != NULL)
+    } 
+  setInterrupts();
+  if(theReactionGroup && !theReactionGroup->isEmpty())
+    {
+      theReactionGroup->setPriorityQueue(&thePriorityQueue);
+      theReactionGroup->initialize(aCurrentTime);
+      theReactionGroup->setQueueID(thePriorityQueue.push(theReactionGroup));
+    }
+  if(theTauLeapGroup && !theTauLeapGroup->isEmpty())
+    {
+      theTauLeapGroup->setPriorityQueue(&thePriorityQueue);
+      theTauLeapGroup->initialize(aCurrentTime);
+      theTauLeapGroup->setQueueID(thePriorityQueue.push(theTauLeapGroup));
+    }
+  //Only the DiffusionProcesses that share their interval with another one
+  //are grouped, while the remaining ones are queued on their own:
+  for(unsigned int i(0); i != aGroupProcesses.size(); ++i)
+    {
+      if(aGroupProcesses[i].size() == 1)
         {
-          aReactionProcess->setInterrupt(theProcessVector, *i);
+          SpatiocyteProcessInterface* aProcess(
+            dynamic_cast<SpatiocyteProcessInterface*>(aGroupProcesses[i][0]));
+          aProcess->setQueueID(thePriorityQueue.push(aProcess));
+          continue;
         }
-    } 
+      DiffusionGroup* aGroup(new DiffusionGroup(getRng(),
+                                                aGroupIntervals[i]));
+      for(unsigned int j(0); j != aGroupProcesses[i].size(); ++j)
+        {
+          aGroup->addProcess(aGroupProcesses[i][j]);
+        }
+      aGroup->setPriorityQueue(&thePriorityQueue);
+      aGroup->initialize(aCurrentTime);
+      aGroup->setQueueID(thePriorityQueue.push(aGroup));
+      theDiffusionGroups.push_back(aGroup);
+    }
+}
+
+void SpatiocyteStepper::clearDiffusionGroups()
+{
+  for(std::vector<DiffusionGroup*>::iterator i(theDiffusionGroups.begin());
+      i != theDiffusionGroups.end(); ++i)
+    {
+      delete *i;
+    }
+  theDiffusionGroups.clear();
 }
 
 void SpatiocyteStepper::populateComps()
@@ -528,7 +952,7 @@ void SpatiocyteStepper::registerComps()
   theBioSpeciesSize = theSpecies.size();
   //Create one last species to represent a NULL Comp. This is for
   //voxels that do not belong to any Comps:
-  Species* aSpecies(new Species(this, NULL, theSpecies.size(), 0, getRng()));
+  Species* aSpecies(new Species(this, NULL, theSpecies.size(), 0));
   theSpecies.push_back(aSpecies);
   aSpecies->setComp(NULL);
   theNullID = aSpecies->getID(); 
@@ -832,93 +1256,366 @@ void SpatiocyteStepper::setLatticeProperties()
   //Drop back the start coordinate to the first voxel of the lattice:
   theStartCoord -= theStartCoord%(theRowSize*theLayerSize*
                                 (theStartCoord/(theRowSize*theLayerSize)));
-  theLattice.resize(theRowSize*theLayerSize*theColSize);
-}
-
-void SpatiocyteStepper::storeSimulationParameters()
-{
-  for(unsigned int i(0); i != theComps.size(); ++i)
+  theBrickRowSize = (theRowSize+LATTICE_BRICK_SIZE-1)/LATTICE_BRICK_SIZE;
+  theBrickLayerSize = (theLayerSize+LATTICE_BRICK_SIZE-1)/LATTICE_BRICK_SIZE;
+  theBrickColSize = (theColSize+LATTICE_BRICK_SIZE-1)/LATTICE_BRICK_SIZE;
+  unsigned int aLatticeSize(theRowSize*theLayerSize*theColSize);
+  switch(LatticeOrder)
     {
-      Comp* aComp(theComps[i]); 
-      if(aComp->dimension == 2)
+    case ROW_MAJOR_ORDER:
+      break;
+    case MORTON_ORDER:
+      //The implicit adjoining voxels are found from fixed offsets in the
+      //row-major lattice:
+      if(ImplicitAdjoining)
         {
-          aComp->actualArea =  (72*pow(VoxelRadius,2))*
-            aComp->coords.size()/(6*pow(2,0.5)+4*pow(3,0.5)+
-                                         3*pow(6, 0.5));
-        }
-      else // (aComp->dimension == 3)
-        { 
-          int voxelCnt(aComp->coords.size());
-          for(unsigned int j(0); j != aComp->allSubs.size(); ++j)
-            {
-              voxelCnt += aComp->allSubs[j]->coords.size();
-            }
-          aComp->actualVolume = (4*pow(2,0.5)*pow(VoxelRadius,3))*
-            voxelCnt;
+          THROW_EXCEPTION(ValueError, 
+                          getPropertyInterface().getClassName() +
+                          ": ImplicitAdjoining requires the row-major " +
+                          "LatticeOrder.");
         }
-    }
+      //The bricks at the edges of the lattice are also complete:
+      aLatticeSize = theBrickRowSize*theBrickLayerSize*theBrickColSize*
+        LATTICE_BRICK_SIZE*LATTICE_BRICK_SIZE*LATTICE_BRICK_SIZE;
+      break;
+    default:
+      THROW_EXCEPTION(ValueError, 
+                      getPropertyInterface().getClassName() +
+                      ": LatticeOrder must be 0 (row-major) or 1 (Morton).");
+    }
+  theLattice.resize(aLatticeSize);
+  theIDs.resize(aLatticeSize);
+  theMoleculeIndices.resize(aLatticeSize);
+  initSurfaceVoxels();
+  setAdjoiningOffsets();
 }
 
-void SpatiocyteStepper::printSimulationParameters()
+//The displacement of the adjoining voxel in the given direction depends on
+//the class of the source voxel. For the HCP lattice there are four classes
+//given by the parities of (layer+col) and col. The cubic lattice only has a
+//single class:
+void SpatiocyteStepper::getAdjoiningDisplacement(unsigned int aClass,
+                                                 unsigned int aDirection,
+                                                 int* aRow, int* aLayer,
+                                                 int* aCol)
 {
-  std::cout << std::endl;
-  std::cout << "   Voxel radius, r_v:" << VoxelRadius << " m" << std::endl;
-  std::cout << "   Simulation height:" << theCenterPoint.y*2*VoxelRadius*2 <<
-    " m" << std::endl;
-  std::cout << "   Simulation width:" << theCenterPoint.z*2*VoxelRadius*2 << 
-    " m" << std::endl;
-  std::cout << "   Simulation length:" << theCenterPoint.x*2*VoxelRadius*2 <<
-    " m" << std::endl;
-  std::cout << "   Layer size:" << theLayerSize << std::endl;
-  std::cout << "   Row size:" << theRowSize << std::endl;
-  std::cout << "   Column size:" << theColSize << std::endl;
-  std::cout << "   Total allocated voxels:" << 
-    theRowSize*theLayerSize*theColSize << std::endl;
-  for(unsigned int i(0); i != theComps.size(); ++i)
+  *aRow = 0;
+  *aLayer = 0;
+  *aCol = 0;
+  if(LatticeType == CUBIC_LATTICE)
     {
-      Comp* aComp(theComps[i]);
-      double aSpecVolume(aComp->specVolume);
-      double aSpecArea(aComp->specArea);
-      double anActualVolume(aComp->actualVolume);
-      double anActualArea(aComp->actualArea);
-      switch(aComp->geometry)
+      switch(aDirection)
         {
-        case CUBOID:
-          std::cout << "   Cuboid ";
+        case NORTH:
+          *aRow = -1;
           break;
-        case ELLIPSOID:
-          std::cout << "   Ellipsoid ";
+        case SOUTH:
+          *aRow = 1;
           break;
-        case CYLINDER:
-          std::cout << "   Cylinder (radius=" << aComp->lengthY*VoxelRadius
-            << "m, length=" << (aComp->lengthX)*VoxelRadius*2 << "m) ";
+        case EAST:
+          *aCol = 1;
           break;
-        case ROD:
-          std::cout << "   Rod (radius=" << aComp->lengthY*VoxelRadius << 
-            "m, cylinder length=" <<
-            (aComp->lengthX-aComp->lengthY*2)*VoxelRadius*2 << "m) ";
+        case WEST:
+          *aCol = -1;
           break;
-        }
-      std::cout << aComp->system->getFullID().asString();
-      switch (aComp->dimension)
-      { 
-      case 1:
-          std::cout << " Line compartment:" << std::endl;
+        case DORSAL:
+          *aLayer = 1;
           break;
-      case 2:
-          std::cout << " Surface compartment:" << std::endl;
-          std::cout << "     [" << int(aSpecArea*(6*sqrt(2)+4*sqrt(3)+3*sqrt(6))/
-                              (72*VoxelRadius*VoxelRadius)) << 
-            "] Specified surface voxels {n_s = S_specified*"
-            << "(6*2^0.5+4*3^0.5+3*6^0.5)/(72*r_v^2}" << std::endl;
-          std::cout << "     [" << aComp->coords.size() <<
-            "] Actual surface voxels {n_s}" << std::endl;
-          std::cout << "     [" << aSpecArea << " m^2] Specified surface area " <<
-            "{S_specified}" << std::endl;
-          std::cout << "     [" << anActualArea << " m^2] Actual surface area " <<
-            "{S = (72*r_v^2)*n_s/(6*2^0.5+4*3^0.5+3*6^0.5)}" << std::endl;
+        case VENTRAL:
+          *aLayer = -1;
           break;
-      case 3:
+        }
+      return;
+    }
+  //odd (layer+col):
+  const bool isOddLayerCol(aClass/2);
+  //odd col:
+  const bool isOddCol(aClass%2);
+  //The north and south adjoining voxels of the neighboring layers and
+  //columns are shifted by one row when (layer+col) is even:
+  const int aNorthRow(isOddLayerCol ? 0 : -1);
+  const int aSouthRow(isOddLayerCol ? 1 : 0);
+  switch(aDirection)
+    {
+    case NORTH:
+      *aRow = -1;
+      break;
+    case SOUTH:
+      *aRow = 1;
+      break;
+    case EAST:
+      *aLayer = isOddCol ? 1 : -1;
+      *aCol = 1;
+      break;
+    case WEST:
+      *aLayer = isOddCol ? 1 : -1;
+      *aCol = -1;
+      break;
+    case NW:
+      *aRow = aNorthRow;
+      *aCol = -1;
+      break;
+    case SW:
+      *aRow = aSouthRow;
+      *aCol = -1;
+      break;
+    case NE:
+      *aRow = aNorthRow;
+      *aCol = 1;
+      break;
+    case SE:
+      *aRow = aSouthRow;
+      *aCol = 1;
+      break;
+    case DORSALN:
+      *aRow = aNorthRow;
+      *aLayer = 1;
+      break;
+    case DORSALS:
+      *aRow = aSouthRow;
+      *aLayer = 1;
+      break;
+    case VENTRALN:
+      *aRow = aNorthRow;
+      *aLayer = -1;
+      break;
+    case VENTRALS:
+      *aRow = aSouthRow;
+      *aLayer = -1;
+      break;
+    }
+}
+
+void SpatiocyteStepper::setAdjoiningOffsets()
+{
+  unsigned int aClassSize(1);
+  if(LatticeType == HCP_LATTICE)
+    {
+      aClassSize = 4;
+    }
+  theAdjoiningOffsets.resize(aClassSize*theAdjoiningVoxelSize);
+  for(unsigned int i(0); i != aClassSize; ++i)
+    {
+      for(unsigned int j(0); j != theAdjoiningVoxelSize; ++j)
+        {
+          int aRow;
+          int aLayer;
+          int aCol;
+          getAdjoiningDisplacement(i, j, &aRow, &aLayer, &aCol);
+          theAdjoiningOffsets[i*theAdjoiningVoxelSize+j] = aRow+
+            aLayer*int(theRowSize)+aCol*int(theRowSize*theLayerSize);
+        }
+    }
+  //The class of each row line of voxels along the (layer, col) plane:
+  theAdjoiningClasses.resize(theLayerSize*theColSize);
+  for(unsigned int aCol(0); aCol != theColSize; ++aCol)
+    {
+      for(unsigned int aLayer(0); aLayer != theLayerSize; ++aLayer)
+        {
+          unsigned char aClass(0);
+          if(LatticeType == HCP_LATTICE)
+            {
+              aClass = ((aLayer+aCol)%2)*2+aCol%2;
+            }
+          theAdjoiningClasses[aLayer+aCol*theLayerSize] = aClass;
+        }
+    }
+}
+
+//The voxels at the two outermost rows, layers and columns of the lattice
+//must keep their adjoiningVoxels arrays because they may point to
+//themselves or be redirected to the opposite side by the periodic
+//boundary conditions:
+bool SpatiocyteStepper::isExplicitAdjoiningCoord(unsigned int aCoord)
+{
+  if(!ImplicitAdjoining)
+    {
+      return true;
+    }
+  unsigned int aRow;
+  unsigned int aLayer;
+  unsigned int aCol;
+  coord2global(aCoord+theStartCoord, &aRow, &aLayer, &aCol);
+  return (aRow <= 1 || aRow+2 >= theRowSize || aLayer <= 1 ||
+          aLayer+2 >= theLayerSize || aCol <= 1 || aCol+2 >= theColSize);
+}
+
+//Create and fill the adjoiningVoxels array of aVoxel from the lattice
+//offsets. Adjoining voxels that fall outside the lattice point to aVoxel
+//itself:
+void SpatiocyteStepper::setAdjoiningVoxels(Voxel* aVoxel)
+{
+  unsigned int aRow;
+  unsigned int aLayer;
+  unsigned int aCol;
+  coord2global(aVoxel->coord, &aRow, &aLayer, &aCol);
+  if(!aVoxel->adjoiningVoxels)
+    {
+      aVoxel->adjoiningVoxels = new Voxel*[theAdjoiningVoxelSize];
+    }
+  const unsigned int aClass(theAdjoiningClasses[aLayer+aCol*theLayerSize]);
+  for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
+    {
+      int aRowDisp;
+      int aLayerDisp;
+      int aColDisp;
+      getAdjoiningDisplacement(aClass, i, &aRowDisp, &aLayerDisp, &aColDisp);
+      const int anAdjoiningRow(int(aRow)+aRowDisp);
+      const int anAdjoiningLayer(int(aLayer)+aLayerDisp);
+      const int anAdjoiningCol(int(aCol)+aColDisp);
+      if(anAdjoiningRow < 0 || anAdjoiningRow >= int(theRowSize) ||
+         anAdjoiningLayer < 0 || anAdjoiningLayer >= int(theLayerSize) ||
+         anAdjoiningCol < 0 || anAdjoiningCol >= int(theColSize))
+        {
+          aVoxel->adjoiningVoxels[i] = aVoxel;
+        }
+      else
+        {
+          aVoxel->adjoiningVoxels[i] = &theLattice[global2index(
+                    anAdjoiningRow, anAdjoiningLayer, anAdjoiningCol)];
+        }
+    }
+}
+
+void SpatiocyteStepper::storeSimulationParameters()
+{
+  theExplicitAdjoiningSize = 0;
+  for(std::vector<Voxel>::iterator i(theLattice.begin());
+      i != theLattice.end(); ++i)
+    {
+      if((*i).adjoiningVoxels)
+        {
+          ++theExplicitAdjoiningSize;
+        }
+    }
+  setCompActualSizes();
+}
+
+void SpatiocyteStepper::setCompActualSizes()
+{
+  for(unsigned int i(0); i != theComps.size(); ++i)
+    {
+      Comp* aComp(theComps[i]); 
+      if(aComp->dimension == 2)
+        {
+          aComp->actualArea =  (72*pow(VoxelRadius,2))*
+            aComp->coords.size()/(6*pow(2,0.5)+4*pow(3,0.5)+
+                                         3*pow(6, 0.5));
+        }
+      else // (aComp->dimension == 3)
+        { 
+          int voxelCnt(aComp->coords.size());
+          for(unsigned int j(0); j != aComp->allSubs.size(); ++j)
+            {
+              voxelCnt += aComp->allSubs[j]->coords.size();
+            }
+          aComp->actualVolume = (4*pow(2,0.5)*pow(VoxelRadius,3))*
+            voxelCnt;
+        }
+    }
+}
+
+void SpatiocyteStepper::printSimulationParameters()
+{
+  std::cout << std::endl;
+  std::cout << "   Voxel radius, r_v:" << VoxelRadius << " m" << std::endl;
+  std::cout << "   Simulation height:" << theCenterPoint.y*2*VoxelRadius*2 <<
+    " m" << std::endl;
+  std::cout << "   Simulation width:" << theCenterPoint.z*2*VoxelRadius*2 << 
+    " m" << std::endl;
+  std::cout << "   Simulation length:" << theCenterPoint.x*2*VoxelRadius*2 <<
+    " m" << std::endl;
+  std::cout << "   Layer size:" << theLayerSize << std::endl;
+  std::cout << "   Row size:" << theRowSize << std::endl;
+  std::cout << "   Column size:" << theColSize << std::endl;
+  std::cout << "   Total allocated voxels:" << 
+    theRowSize*theLayerSize*theColSize << std::endl;
+  if(ThreadSize > 1)
+    {
+      std::cout << "   Walk threads:" << ThreadSize << " (" <<
+        ThreadSize*2 << " column sectors)" << std::endl;
+    }
+  if(RandomEngine == PHILOX_RANDOM)
+    {
+      std::cout << "   Species random engine: Philox4x32-10" << std::endl;
+    }
+  if(QueueArity != 2)
+    {
+      std::cout << "   Priority queue arity:" << QueueArity << std::endl;
+    }
+  if(SortInterval)
+    {
+      std::cout << "   Molecule sort interval:" << SortInterval << " walks" <<
+        std::endl;
+    }
+  if(LatticeOrder == MORTON_ORDER)
+    {
+      std::cout << "   Lattice order: Morton in " << LATTICE_BRICK_SIZE <<
+        "^3 voxel bricks" << std::endl;
+    }
+  if(ImplicitAdjoining)
+    {
+      std::cout << "   Voxels with explicit adjoining voxels:" << 
+        theExplicitAdjoiningSize << std::endl;
+    }
+  else if(!theLatticeBricks.empty())
+    {
+      std::cout << "   Allocated adjoining voxel bricks:" << 
+        theLatticeBricks.size()-std::count(theLatticeBricks.begin(),
+          theLatticeBricks.end(), (Voxel**)NULL) << " of " <<
+        theLatticeBricks.size() << std::endl;
+    }
+  std::cout << "   Initialization times:" << std::endl;
+  for(unsigned int i(0); i != theInitTimes.size(); ++i)
+    {
+      std::cout << "     [" << theInitTimes[i].second << " s] " <<
+        theInitTimes[i].first << std::endl;
+    }
+  for(unsigned int i(0); i != theComps.size(); ++i)
+    {
+      Comp* aComp(theComps[i]);
+      double aSpecVolume(aComp->specVolume);
+      double aSpecArea(aComp->specArea);
+      double anActualVolume(aComp->actualVolume);
+      double anActualArea(aComp->actualArea);
+      switch(aComp->geometry)
+        {
+        case CUBOID:
+          std::cout << "   Cuboid ";
+          break;
+        case ELLIPSOID:
+          std::cout << "   Ellipsoid ";
+          break;
+        case CYLINDER:
+          std::cout << "   Cylinder (radius=" << aComp->lengthY*VoxelRadius
+            << "m, length=" << (aComp->lengthX)*VoxelRadius*2 << "m) ";
+          break;
+        case ROD:
+          std::cout << "   Rod (radius=" << aComp->lengthY*VoxelRadius << 
+            "m, cylinder length=" <<
+            (aComp->lengthX-aComp->lengthY*2)*VoxelRadius*2 << "m) ";
+          break;
+        }
+      std::cout << aComp->system->getFullID().asString();
+      switch (aComp->dimension)
+      { 
+      case 1:
+          std::cout << " Line compartment:" << std::endl;
+          break;
+      case 2:
+          std::cout << " Surface compartment:" << std::endl;
+          std::cout << "     [" << int(aSpecArea*(6*sqrt(2)+4*sqrt(3)+3*sqrt(6))/
+                              (72*VoxelRadius*VoxelRadius)) << 
+            "] Specified surface voxels {n_s = S_specified*"
+            << "(6*2^0.5+4*3^0.5+3*6^0.5)/(72*r_v^2}" << std::endl;
+          std::cout << "     [" << aComp->coords.size() <<
+            "] Actual surface voxels {n_s}" << std::endl;
+          std::cout << "     [" << aSpecArea << " m^2] Specified surface area " <<
+            "{S_specified}" << std::endl;
+          std::cout << "     [" << anActualArea << " m^2] Actual surface area " <<
+            "{S = (72*r_v^2)*n_s/(6*2^0.5+4*3^0.5+3*6^0.5)}" << std::endl;
+          break;
+      case 3:
       default:
           std::cout << " Volume compartment:" << std::endl;
           int voxelCnt(aComp->coords.size());
@@ -1036,55 +1733,284 @@ void SpatiocyteStepper::readjustSurfaceBoundarySizes()
     }
 }
 
+//Each thread constructs the voxels of its own range of columns. A voxel is
+//concatenated with the voxels of the preceding row, layer and column, which
+//may belong to another thread, so the voxels are only concatenated after
+//all of them have been initialized. Every concatenation writes different
+//elements of the adjoiningVoxels arrays, so the threads never conflict.
+//The adjoiningVoxels arrays are allocated in bricks of LATTICE_BRICK_SIZE^3
+//voxels, and the bricks far outside the root Comp are never allocated:
 void SpatiocyteStepper::constructLattice()
 { 
+  //The voxels that only fill up the bricks at the edges of a Morton
+  //ordered lattice are never initialized below:
+  std::fill(theIDs.begin(), theIDs.end(), theNullID);
+  if(!ImplicitAdjoining)
+    {
+      const unsigned int aBrickSize(theBrickRowSize*theBrickLayerSize*
+                                    theBrickColSize);
+      theLatticeBricks.assign(aBrickSize, NULL);
+      theConcatenatedBricks.assign(aBrickSize, false);
+      theConcatenatedVoxels.assign(theLattice.size(), false);
+    }
+  runThreads(&SpatiocyteStepper::initVoxels, this);
+  if(!ImplicitAdjoining)
+    {
+      runThreads(&SpatiocyteStepper::allocateBricks, this);
+      runThreads(&SpatiocyteStepper::concatenateVoxels, this);
+      std::vector<unsigned char>().swap(theConcatenatedVoxels);
+      std::vector<unsigned char>().swap(theConcatenatedBricks);
+    }
+  if(theComps[0]->geometry == CUBOID)
+    {
+      concatenatePeriodicSurfaces();
+    }
+}
+
+void SpatiocyteStepper::initVoxels(void* aStepper, unsigned int aThread)
+{
+  static_cast<SpatiocyteStepper*>(aStepper)->initVoxels(aThread);
+}
+
+void SpatiocyteStepper::initVoxels(unsigned int aThread)
+{
   Comp* aRootComp(theComps[0]);
-  unsigned int aSize(theRowSize*theLayerSize*theColSize);
-  unsigned int a(0);
-  unsigned int b(theStartCoord);
   unsigned short rootID(aRootComp->vacantID);
-  for(std::vector<Voxel>::iterator i(theLattice.begin()); a != aSize; ++i, ++a, ++b)
+  unsigned int aBegin;
+  unsigned int anEnd;
+  getThreadRange(theColSize, aThread, &aBegin, &anEnd);
+  for(unsigned int b(aBegin*theRowSize*theLayerSize);
+      b != anEnd*theRowSize*theLayerSize; ++b)
     { 
-      (*i).adjoiningVoxels = new Voxel*[theAdjoiningVoxelSize];
-      unsigned int aCol(a/(theRowSize*theLayerSize)); 
-      unsigned int aLayer((a%(theRowSize*theLayerSize))/theRowSize); 
-      unsigned int aRow((a%(theRowSize*theLayerSize))%theRowSize); 
-      (*i).coord = b; 
-      if(aRootComp->geometry == CUBOID || isInsideCoord(b, aRootComp, 0))
+      const unsigned int a(coord2index(theStartCoord+b));
+      Voxel* aVoxel(&theLattice[a]);
+      aVoxel->coord = theStartCoord+b; 
+      if(aRootComp->geometry == CUBOID ||
+         isInsideCoord(aVoxel->coord, aRootComp, 0))
         {
           //By default, the voxel is vacant and we set it to the root id:
-          (*i).id = rootID;
-          for(unsigned int j(0); j != theAdjoiningVoxelSize; ++j)
-            { 
-              // By default let the adjoining voxel pointer point to the 
-              // source voxel (i.e., itself)
-              (*i).adjoiningVoxels[j] = &(*i);
-            } 
-          concatenateVoxel(&(*i), aRow, aLayer, aCol);
+          setID(aVoxel, rootID);
         }
       else
         {
           //We set id = theNullID if it is an invalid voxel, i.e., no molecules
           //will occupy it:
-          (*i).id = theNullID;
-          //Concatenate some of the null voxels close to the surface:
-          if(isInsideCoord(b, aRootComp, 4))
+          setID(aVoxel, theNullID);
+        }
+      if(ImplicitAdjoining)
+        {
+          aVoxel->adjoiningVoxels = NULL;
+          if(isExplicitAdjoiningCoord(b))
             {
-              concatenateVoxel(&(*i), aRow, aLayer, aCol);
+              setAdjoiningVoxels(aVoxel);
             }
         }
+      //Concatenate the voxels inside the root Comp and some of the null
+      //voxels close to the surface:
+      else if(getID(aVoxel) == rootID ||
+              isInsideCoord(aVoxel->coord, aRootComp, 4))
+        {
+          theConcatenatedVoxels[a] = true;
+        }
     }
-  if(aRootComp->geometry == CUBOID)
+}
+
+void SpatiocyteStepper::allocateBricks(void* aStepper, unsigned int aThread)
+{
+  static_cast<SpatiocyteStepper*>(aStepper)->allocateBricks(aThread);
+}
+
+//A concatenated voxel also writes into the adjoiningVoxels arrays of its
+//adjoining voxels, which may be in any of the 26 surrounding bricks. So a
+//brick is allocated if it or one of its surrounding bricks has a
+//concatenated voxel. The voxels of the remaining bricks are never accessed
+//through their adjoiningVoxels arrays, which are left NULL:
+void SpatiocyteStepper::allocateBricks(unsigned int aThread)
+{
+  unsigned int aBegin;
+  unsigned int anEnd;
+  getThreadRange(theBrickColSize, aThread, &aBegin, &anEnd);
+  for(unsigned int col(aBegin); col != anEnd; ++col)
     {
-      concatenatePeriodicSurfaces();
+      for(unsigned int layer(0); layer != theBrickLayerSize; ++layer)
+        {
+          for(unsigned int row(0); row != theBrickRowSize; ++row)
+            {
+              theConcatenatedBricks[getBrick(row, layer, col)] =
+                isConcatenatedBrick(row, layer, col);
+            }
+        }
+    }
+  waitThreads();
+  const unsigned short rootID(theComps[0]->vacantID);
+  for(unsigned int col(aBegin); col != anEnd; ++col)
+    {
+      for(unsigned int layer(0); layer != theBrickLayerSize; ++layer)
+        {
+          for(unsigned int row(0); row != theBrickRowSize; ++row)
+            {
+              if(!hasConcatenatedBrick(row, layer, col))
+                {
+                  continue;
+                }
+              Voxel** aBrick(new Voxel*[LATTICE_BRICK_SIZE*LATTICE_BRICK_SIZE*
+                                LATTICE_BRICK_SIZE*theAdjoiningVoxelSize]);
+              theLatticeBricks[getBrick(row, layer, col)] = aBrick;
+              for(unsigned int c(col*LATTICE_BRICK_SIZE); c != std::min(
+                  (col+1)*LATTICE_BRICK_SIZE, theColSize); ++c)
+                {
+                  for(unsigned int l(layer*LATTICE_BRICK_SIZE); l != std::min(
+                      (layer+1)*LATTICE_BRICK_SIZE, theLayerSize); ++l)
+                    {
+                      for(unsigned int r(row*LATTICE_BRICK_SIZE); r != std::min(
+                          (row+1)*LATTICE_BRICK_SIZE, theRowSize); ++r)
+                        {
+                          Voxel* aVoxel(&theLattice[global2index(r, l, c)]);
+                          aVoxel->adjoiningVoxels = aBrick;
+                          aBrick += theAdjoiningVoxelSize;
+                          if(getID(aVoxel) == rootID)
+                            {
+                              for(unsigned int j(0);
+                                  j != theAdjoiningVoxelSize; ++j)
+                                { 
+                                  // By default let the adjoining voxel
+                                  // pointer point to the source voxel
+                                  // (i.e., itself)
+                                  aVoxel->adjoiningVoxels[j] = aVoxel;
+                                } 
+                            }
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
+unsigned int SpatiocyteStepper::getBrick(unsigned int aRow,
+                                         unsigned int aLayer,
+                                         unsigned int aCol)
+{
+  return aRow+theBrickRowSize*aLayer+theBrickRowSize*theBrickLayerSize*aCol;
+}
+
+bool SpatiocyteStepper::isConcatenatedBrick(unsigned int aRow,
+                                            unsigned int aLayer,
+                                            unsigned int aCol)
+{
+  for(unsigned int c(aCol*LATTICE_BRICK_SIZE); c != std::min(
+      (aCol+1)*LATTICE_BRICK_SIZE, theColSize); ++c)
+    {
+      for(unsigned int l(aLayer*LATTICE_BRICK_SIZE); l != std::min(
+          (aLayer+1)*LATTICE_BRICK_SIZE, theLayerSize); ++l)
+        {
+          for(unsigned int r(aRow*LATTICE_BRICK_SIZE); r != std::min(
+              (aRow+1)*LATTICE_BRICK_SIZE, theRowSize); ++r)
+            {
+              if(theConcatenatedVoxels[global2index(r, l, c)])
+                {
+                  return true;
+                }
+            }
+        }
+    }
+  return false;
+}
+
+//Checks the brick and its surrounding bricks:
+bool SpatiocyteStepper::hasConcatenatedBrick(unsigned int aRow,
+                                             unsigned int aLayer,
+                                             unsigned int aCol)
+{
+  for(unsigned int c(aCol ? aCol-1 : 0); c != std::min(aCol+2,
+      theBrickColSize); ++c)
+    {
+      for(unsigned int l(aLayer ? aLayer-1 : 0); l != std::min(aLayer+2,
+          theBrickLayerSize); ++l)
+        {
+          for(unsigned int r(aRow ? aRow-1 : 0); r != std::min(aRow+2,
+              theBrickRowSize); ++r)
+            {
+              if(theConcatenatedBricks[getBrick(r, l, c)])
+                {
+                  return true;
+                }
+            }
+        }
+    }
+  return false;
+}
+
+void SpatiocyteStepper::concatenateVoxels(void* aStepper,
+                                          unsigned int aThread)
+{
+  static_cast<SpatiocyteStepper*>(aStepper)->concatenateVoxels(aThread);
+}
+
+void SpatiocyteStepper::concatenateVoxels(unsigned int aThread)
+{
+  unsigned int aBegin;
+  unsigned int anEnd;
+  getThreadRange(theColSize, aThread, &aBegin, &anEnd);
+  for(unsigned int aCol(aBegin); aCol != anEnd; ++aCol)
+    {
+      for(unsigned int aLayer(0); aLayer != theLayerSize; ++aLayer)
+        {
+          for(unsigned int aRow(0); aRow != theRowSize; ++aRow)
+            {
+              const unsigned int a(global2index(aRow, aLayer, aCol));
+              if(theConcatenatedVoxels[a])
+                {
+                  concatenateVoxel(&theLattice[a], aRow, aLayer, aCol);
+                }
+            }
+        }
+    }
+}
+
+//Splits aSize items into ThreadSize contiguous ranges of almost equal
+//sizes and returns the range [aBegin, anEnd) of aThread:
+void SpatiocyteStepper::getThreadRange(unsigned int aSize,
+                                       unsigned int aThread,
+                                       unsigned int* aBegin,
+                                       unsigned int* anEnd)
+{
+  const unsigned int aRangeSize(aSize/ThreadSize);
+  const unsigned int aRemainder(aSize%ThreadSize);
+  *aBegin = aThread*aRangeSize+std::min(aThread, aRemainder);
+  *anEnd = *aBegin+aRangeSize+(aThread < aRemainder);
+}
+
 void SpatiocyteStepper::setPeriodicEdge()
 {
   isPeriodicEdge = true;
 }
 
+//The voxels that getPeriodicVoxel relocates are flagged once so that the
+//walk can report the molecules that have moved onto a periodic boundary
+//without computing the global coordinates of every molecule:
+void SpatiocyteStepper::setBoundaryFlags()
+{
+  theBoundaryFlags.assign(theLattice.size(), 0);
+  for(unsigned int i(0); i != theLattice.size(); ++i)
+    {
+      unsigned int aRow;
+      unsigned int aLayer;
+      unsigned int aCol;
+      coord2global(theLattice[i].coord, &aRow, &aLayer, &aCol);
+      //The boundary of surface species is one voxel further inside:
+      for(unsigned int adj(0); adj != 2; ++adj)
+        {
+          if(aRow == 1+adj || aRow == theRowSize-(2+adj) ||
+             aLayer == 1+adj || aLayer == theLayerSize-(2+adj) ||
+             aCol == 1+adj || aCol == theColSize-(2+adj))
+            {
+              theBoundaryFlags[i] |= adj ? SURFACE_BOUNDARY : VOLUME_BOUNDARY;
+            }
+        }
+    }
+}
+
 bool SpatiocyteStepper::isPeriodicEdgeCoord(unsigned int aCoord, Comp* aComp)
 {
   unsigned int aRow;
@@ -1428,22 +2354,7 @@ Point SpatiocyteStepper::coord2point(unsigned int aCoord)
   unsigned int aGlobalRow;
   coord2global(aCoord, &aGlobalRow, &aGlobalLayer, &aGlobalCol);
   //the center point of a voxel 
-  Point aPoint;
-  switch(LatticeType)
-    {
-    case HCP_LATTICE: 
-      aPoint.y = (aGlobalCol%2)*theHCPk+theHCPl*aGlobalLayer;
-      aPoint.z = aGlobalRow*2*theNormalizedVoxelRadius+
-        ((aGlobalLayer+aGlobalCol)%2)*theNormalizedVoxelRadius;
-      aPoint.x = aGlobalCol*theHCPh;
-      break;
-    case CUBIC_LATTICE:
-      aPoint.y = aGlobalLayer*2*theNormalizedVoxelRadius;
-      aPoint.z = aGlobalRow*2*theNormalizedVoxelRadius;
-      aPoint.x = aGlobalCol*2*theNormalizedVoxelRadius;
-      break;
-    }
-  return aPoint;
+  return global2point(aGlobalRow, aGlobalLayer, aGlobalCol);
 }
 
 Voxel* SpatiocyteStepper::point2voxel(Point aPoint)
@@ -1489,9 +2400,7 @@ Voxel* SpatiocyteStepper::point2voxel(Point aPoint)
     {
       aGlobalLayer = theLayerSize-1;
     }
-  return &theLattice[aGlobalRow+
-                     theRowSize*aGlobalLayer+
-                     theRowSize*theLayerSize*aGlobalCol];
+  return &theLattice[global2index(aGlobalRow, aGlobalLayer, aGlobalCol)];
 }
 
 void SpatiocyteStepper::coord2global(unsigned int aCoord,
@@ -1509,10 +2418,7 @@ void SpatiocyteStepper::concatenateLayers(Voxel* aVoxel,
                                           unsigned int aLayer,
                                           unsigned int aCol)
 {
-  Voxel* anAdjoiningVoxel(&theLattice[
-                          aRow+
-                          theRowSize*aLayer+
-                          theRowSize*theLayerSize*aCol]);
+  Voxel* anAdjoiningVoxel(&theLattice[global2index(aRow, aLayer, aCol)]);
   switch(LatticeType)
     {
     case HCP_LATTICE: 
@@ -1536,10 +2442,8 @@ void SpatiocyteStepper::concatenateLayers(Voxel* aVoxel,
           anAdjoiningVoxel->adjoiningVoxels[DORSALN] = aVoxel;
           if(aRow > 0)
             {
-              anAdjoiningVoxel = (&theLattice[
-                                  aRow-1+ 
-                                  theRowSize*aLayer+
-                                  theRowSize*theLayerSize*aCol]);
+              anAdjoiningVoxel = (&theLattice[global2index(aRow-1, aLayer,
+                                                           aCol)]);
               aVoxel->adjoiningVoxels[VENTRALN] = anAdjoiningVoxel;
               anAdjoiningVoxel->adjoiningVoxels[DORSALS] = aVoxel;
             }
@@ -1558,10 +2462,7 @@ void SpatiocyteStepper::concatenateCols(Voxel* aVoxel,
                                         unsigned int aLayer,
                                         unsigned int aCol)
 {
-  Voxel* anAdjoiningVoxel(&theLattice[
-                          aRow+
-                          theRowSize*aLayer+
-                          theRowSize*theLayerSize*aCol]);
+  Voxel* anAdjoiningVoxel(&theLattice[global2index(aRow, aLayer, aCol)]);
   switch(LatticeType)
     {
     case HCP_LATTICE: 
@@ -1596,19 +2497,15 @@ void SpatiocyteStepper::concatenateCols(Voxel* aVoxel,
               anAdjoiningVoxel->adjoiningVoxels[NE] = aVoxel;
               if(aRow > 0)
                 {
-                  anAdjoiningVoxel = (&theLattice[
-                                      aRow-1+ 
-                                      theRowSize*aLayer+
-                                      theRowSize*theLayerSize*aCol]);
+                  anAdjoiningVoxel = (&theLattice[global2index(aRow-1, aLayer,
+                                                               aCol)]);
                   aVoxel->adjoiningVoxels[NW] = anAdjoiningVoxel;
                   anAdjoiningVoxel->adjoiningVoxels[SE] = aVoxel;
                 }
               if(aLayer > 0)
                 {
-                  anAdjoiningVoxel = (&theLattice[
-                                      aRow+ 
-                                      theRowSize*(aLayer-1)+
-                                      theRowSize*theLayerSize*aCol]);
+                  anAdjoiningVoxel = (&theLattice[global2index(aRow, aLayer-1,
+                                                               aCol)]);
                   aVoxel->adjoiningVoxels[WEST] = anAdjoiningVoxel;
                   anAdjoiningVoxel->adjoiningVoxels[EAST] = aVoxel;
                 }
@@ -1622,10 +2519,8 @@ void SpatiocyteStepper::concatenateCols(Voxel* aVoxel,
               anAdjoiningVoxel->adjoiningVoxels[NE] = aVoxel;
               if(aRow > 0)
                 {
-                  anAdjoiningVoxel = (&theLattice[
-                                      aRow-1+ 
-                                      theRowSize*aLayer+
-                                      theRowSize*theLayerSize*aCol]);
+                  anAdjoiningVoxel = (&theLattice[global2index(aRow-1, aLayer,
+                                                               aCol)]);
                   aVoxel->adjoiningVoxels[NW] = anAdjoiningVoxel;
                   anAdjoiningVoxel->adjoiningVoxels[SE] = aVoxel;
                 }
@@ -1654,10 +2549,8 @@ void SpatiocyteStepper::concatenateCols(Voxel* aVoxel,
                 }
               if(aLayer > 0)
                 {
-                  anAdjoiningVoxel = (&theLattice[
-                                      aRow+ 
-                                      theRowSize*(aLayer-1)+
-                                      theRowSize*theLayerSize*aCol]);
+                  anAdjoiningVoxel = (&theLattice[global2index(aRow, aLayer-1,
+                                                               aCol)]);
                   aVoxel->adjoiningVoxels[WEST] = anAdjoiningVoxel;
                   anAdjoiningVoxel->adjoiningVoxels[EAST] = aVoxel;
                 }
@@ -1676,10 +2569,7 @@ void SpatiocyteStepper::concatenateRows(Voxel* aVoxel,
                                         unsigned int aLayer,
                                         unsigned int aCol)
 {
-  Voxel* anAdjoiningVoxel(&theLattice[
-                          aRow+ 
-                          theRowSize*aLayer+ 
-                          theRowSize*theLayerSize*aCol]);
+  Voxel* anAdjoiningVoxel(&theLattice[global2index(aRow, aLayer, aCol)]);
   aVoxel->adjoiningVoxels[NORTH] = anAdjoiningVoxel;
   anAdjoiningVoxel->adjoiningVoxels[SOUTH] = aVoxel;
 }
@@ -1692,14 +2582,10 @@ void SpatiocyteStepper::concatenatePeriodicSurfaces()
       i+=theRowSize)
     {
       unsigned int j(i+theRowSize-1);
-      Voxel* aSrcVoxel(&theLattice[
-                       coord2row(i)+ 
-                       theRowSize*coord2layer(i)+ 
-                       theRowSize*theLayerSize*coord2col(i)]); 
-      Voxel* aDestVoxel(&theLattice[
-                        coord2row(j)+
-                        theRowSize*coord2layer(i)+
-                        theRowSize*theLayerSize*coord2col(i)]); 
+      Voxel* aSrcVoxel(&theLattice[global2index(coord2row(i), coord2layer(i),
+                                                coord2col(i))]); 
+      Voxel* aDestVoxel(&theLattice[global2index(coord2row(j), coord2layer(i),
+                                                 coord2col(i))]); 
       if(aRootComp->xyPlane == UNIPERIODIC)
         { 
           replaceUniVoxel(aSrcVoxel, aDestVoxel);
@@ -1713,21 +2599,17 @@ void SpatiocyteStepper::concatenatePeriodicSurfaces()
           //We cannot have valid voxels pointing to itself it it is not periodic
           //to avoid incorrect homodimerization reaction. So we set such
           //molecules to null ID.
-          aSrcVoxel->id = theNullID;
-          aDestVoxel->id = theNullID;
+          setID(aSrcVoxel, theNullID);
+          setID(aDestVoxel, theNullID);
         }
     }
   for(unsigned int i(0); i<=theRowSize*theLayerSize*(theColSize-1)+theRowSize;)
     {
       unsigned int j(theRowSize*(theLayerSize-1)+i);
-      Voxel* aSrcVoxel(&theLattice[
-                       coord2row(i)+
-                       theRowSize*coord2layer(i)+ 
-                       theRowSize*theLayerSize*coord2col(i)]); 
-      Voxel* aDestVoxel(&theLattice[
-                        coord2row(i)+
-                        theRowSize*coord2layer(j)+ 
-                        theRowSize*theLayerSize*coord2col(i)]); 
+      Voxel* aSrcVoxel(&theLattice[global2index(coord2row(i), coord2layer(i),
+                                                coord2col(i))]); 
+      Voxel* aDestVoxel(&theLattice[global2index(coord2row(i), coord2layer(j),
+                                                 coord2col(i))]); 
 
       if(aRootComp->xzPlane == UNIPERIODIC)
         { 
@@ -1739,8 +2621,8 @@ void SpatiocyteStepper::concatenatePeriodicSurfaces()
         }
       else if(!isPeriodicEdge)
         {
-          aSrcVoxel->id = theNullID;
-          aDestVoxel->id = theNullID;
+          setID(aSrcVoxel, theNullID);
+          setID(aDestVoxel, theNullID);
         }
       ++i;
       if(coord2layer(i) != 0)
@@ -1750,14 +2632,10 @@ void SpatiocyteStepper::concatenatePeriodicSurfaces()
     }
   for(unsigned int i(0); i!=theRowSize*theLayerSize; ++i)
     {
-      Voxel* aSrcVoxel(&theLattice[
-                       coord2row(i)+
-                       theRowSize*coord2layer(i)+ 
-                       theRowSize*theLayerSize*0]); 
-      Voxel* aDestVoxel(&theLattice[
-                        coord2row(i)+
-                        theRowSize*coord2layer(i)+ 
-                        theRowSize*theLayerSize*(theColSize-1)]); 
+      Voxel* aSrcVoxel(&theLattice[global2index(coord2row(i), coord2layer(i),
+                                                0)]); 
+      Voxel* aDestVoxel(&theLattice[global2index(coord2row(i), coord2layer(i),
+                                                 theColSize-1)]); 
       if(aRootComp->yzPlane == UNIPERIODIC)
         { 
           replaceUniVoxel(aSrcVoxel, aDestVoxel);
@@ -1768,8 +2646,8 @@ void SpatiocyteStepper::concatenatePeriodicSurfaces()
         }
       else if(!isPeriodicEdge)
         {
-          aSrcVoxel->id = theNullID;
-          aDestVoxel->id = theNullID;
+          setID(aSrcVoxel, theNullID);
+          setID(aDestVoxel, theNullID);
         }
     }
 }
@@ -1791,7 +2669,7 @@ unsigned int SpatiocyteStepper::coord2col(unsigned int aCoord)
 
 void SpatiocyteStepper::replaceVoxel(Voxel* aSrcVoxel, Voxel* aDestVoxel)
 {
-  if(aSrcVoxel->id != theNullID && aDestVoxel->id != theNullID)
+  if(getID(aSrcVoxel) != theNullID && getID(aDestVoxel) != theNullID)
     {
       for(unsigned int j(0); j!=theAdjoiningVoxelSize; ++j)
         {
@@ -1810,65 +2688,561 @@ void SpatiocyteStepper::replaceVoxel(Voxel* aSrcVoxel, Voxel* aDestVoxel)
                 }
             }
         }
-      aDestVoxel->id = theNullID;
+      setID(aDestVoxel, theNullID);
     }
 }
 
 void SpatiocyteStepper::replaceUniVoxel(Voxel* aSrcVoxel, Voxel* aDestVoxel)
 {
-  if(aSrcVoxel->id != theNullID && aDestVoxel->id != theNullID)
+  if(getID(aSrcVoxel) != theNullID && getID(aDestVoxel) != theNullID)
+    {
+      for(unsigned int j(0); j!=theAdjoiningVoxelSize; ++j)
+        {
+          if(aSrcVoxel->adjoiningVoxels[j] == aSrcVoxel)
+            {
+              for(unsigned int k(0); k!=theAdjoiningVoxelSize; ++k)
+                {
+                  if(aDestVoxel->adjoiningVoxels[j]->adjoiningVoxels[k] ==
+                     aDestVoxel)
+                    {
+                      aDestVoxel->adjoiningVoxels[j]->adjoiningVoxels[k] =
+                        aSrcVoxel;
+                    }
+                }
+            }
+        }
+      setID(aDestVoxel, theNullID);
+    }
+}
+
+void SpatiocyteStepper::shuffleAdjoiningVoxels()
+{
+  for(std::vector<Voxel>::iterator i(theLattice.begin()); i != theLattice.end(); ++i)
+    {
+      if(getID(&(*i)) != theNullID && (*i).adjoiningVoxels)
+        { 
+          gsl_ran_shuffle(getRng(), (*i).adjoiningVoxels, theAdjoiningVoxelSize,
+                          sizeof(Voxel*));
+        }
+    }
+}
+
+void SpatiocyteStepper::setCompVoxelProperties()
+{
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      switch ((*i)->dimension)
+        {
+        case 1:
+          setLineCompProperties(*i);
+          setLineVoxelProperties(*i);
+          break;
+        case 2:
+          setSurfaceCompProperties(*i);
+          setSurfaceVoxelProperties(*i);
+          break;
+        case 3:
+        default:
+            setVolumeCompProperties(*i);
+        }
+    }
+  initVacantVoxels();
+}
+
+//From here on, setID and swapID keep Comp::vacantVoxels of every Comp and
+//the molecule list of every diffuse vacant species up to date:
+void SpatiocyteStepper::initVacantVoxels()
+{
+  theVacantComps.assign(theSpecies.size(), NULL);
+  theVoxelLists.assign(theSpecies.size(), NULL);
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      (*i)->vacantVoxels.clear();
+      for(std::vector<unsigned int>::iterator j((*i)->coords.begin());
+          j != (*i)->coords.end(); ++j)
+        {
+          if(theIDs[*j] == (*i)->vacantID)
+            {
+              theMoleculeIndices[*j] = (*i)->vacantVoxels.size();
+              (*i)->vacantVoxels.push_back(&theLattice[*j]);
+            }
+        }
+    }
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      theVacantComps[(*i)->vacantID] = *i;
+      theVoxelLists[(*i)->vacantID] = &(*i)->vacantVoxels;
+    }
+  //The vacant species of a Comp is already tracked by its Comp:
+  for(std::vector<Species*>::iterator i(theSpecies.begin());
+      i != theSpecies.end(); ++i)
+    {
+      if((*i)->getIsDiffuseVacant() && !(*i)->getIsVacant())
+        {
+          const unsigned short anID((*i)->getID());
+          std::vector<Voxel*>& aMolecules((*i)->getMolecules());
+          aMolecules.clear();
+          std::vector<unsigned int>& coords((*i)->getComp()->coords);
+          for(std::vector<unsigned int>::iterator j(coords.begin());
+              j != coords.end(); ++j)
+            {
+              if(theIDs[*j] == anID)
+                {
+                  theMoleculeIndices[*j] = aMolecules.size();
+                  aMolecules.push_back(&theLattice[*j]);
+                }
+            }
+          theVoxelLists[anID] = &aMolecules;
+          (*i)->updateDiffuseVacantMolecules();
+        }
+    }
+}
+
+//The lattice file is written in the native byte order of the machine:
+//  LATTICE_FILE_MAGIC, LATTICE_FILE_VERSION, the geometry hash,
+//  the lattice size, the adjoining voxel size and the number of Comps,
+//  the ID and the adjoiningSize of every voxel,
+//  the explicit adjoiningVoxels arrays as voxel indices,
+//  the offsets and voxel indices of each type of surface voxel lists,
+//  the surfaceIndex of the surface voxels,
+//  the coords, diffusiveComp and surface dimensions of every Comp.
+template<typename T>
+void writeLatticeValue(std::ofstream& aFile, T const& aValue)
+{
+  aFile.write(reinterpret_cast<const char*>(&aValue), sizeof(T));
+}
+
+template<typename T>
+void writeLatticeVector(std::ofstream& aFile, std::vector<T> const& aVector)
+{
+  if(!aVector.empty())
+    {
+      aFile.write(reinterpret_cast<const char*>(&aVector[0]),
+                  sizeof(T)*aVector.size());
+    }
+}
+
+template<typename T>
+bool readLatticeValue(const char*& aCursor, const char* anEnd, T& aValue)
+{
+  if(size_t(anEnd-aCursor) < sizeof(T))
+    {
+      return false;
+    }
+  memcpy(&aValue, aCursor, sizeof(T));
+  aCursor += sizeof(T);
+  return true;
+}
+
+template<typename T>
+bool readLatticeVector(const char*& aCursor, const char* anEnd,
+                       std::vector<T>& aVector, unsigned int aSize)
+{
+  if(size_t(anEnd-aCursor)/sizeof(T) < aSize)
+    {
+      return false;
+    }
+  aVector.resize(aSize);
+  if(aSize)
+    {
+      memcpy(&aVector[0], aCursor, sizeof(T)*aSize);
+      aCursor += sizeof(T)*aSize;
+    }
+  return true;
+}
+
+template<typename T>
+void hashLatticeValue(unsigned long long& aHash, T const& aValue)
+{
+  //64-bit FNV-1a:
+  const unsigned char* aByte(reinterpret_cast<const unsigned char*>(&aValue));
+  for(unsigned int i(0); i != sizeof(T); ++i)
+    {
+      aHash = (aHash^aByte[i])*1099511628211ULL;
+    }
+}
+
+//The hash of all the parameters that determine the compartmentalized
+//lattice. It is computed before the lattice is constructed:
+unsigned long long SpatiocyteStepper::getGeometryHash()
+{
+  unsigned long long aHash(14695981039346656037ULL);
+  hashLatticeValue(aHash, VoxelRadius);
+  hashLatticeValue(aHash, LatticeType);
+  hashLatticeValue(aHash, LatticeOrder);
+  hashLatticeValue(aHash, ImplicitAdjoining);
+  hashLatticeValue(aHash, isPeriodicEdge);
+  hashLatticeValue(aHash, theStartCoord);
+  hashLatticeValue(aHash, theRowSize);
+  hashLatticeValue(aHash, theLayerSize);
+  hashLatticeValue(aHash, theColSize);
+  hashLatticeValue(aHash, theNullID);
+  for(unsigned int j(0); j != theComps.size(); ++j)
+    {
+      Comp* aComp(theComps[j]);
+      String aFullID(aComp->system->getFullID().asString());
+      FOR_ALL(System::Variables, aComp->system->getVariables())
+        {
+          if(i->second->getID() == "DIFFUSIVE")
+            {
+              aFullID += ":" + i->second->getName();
+            }
+        }
+      for(String::iterator k(aFullID.begin()); k != aFullID.end(); ++k)
+        {
+          hashLatticeValue(aHash, *k);
+        }
+      hashLatticeValue(aHash, aComp->dimension);
+      hashLatticeValue(aHash, aComp->vacantID);
+      hashLatticeValue(aHash, aComp->enclosed);
+      hashLatticeValue(aHash, aComp->geometry);
+      hashLatticeValue(aHash, aComp->xyPlane);
+      hashLatticeValue(aHash, aComp->xzPlane);
+      hashLatticeValue(aHash, aComp->yzPlane);
+      hashLatticeValue(aHash, aComp->lengthX);
+      hashLatticeValue(aHash, aComp->lengthY);
+      hashLatticeValue(aHash, aComp->lengthZ);
+      hashLatticeValue(aHash, aComp->originX);
+      hashLatticeValue(aHash, aComp->originY);
+      hashLatticeValue(aHash, aComp->originZ);
+      hashLatticeValue(aHash, aComp->rotateX);
+      hashLatticeValue(aHash, aComp->rotateY);
+      hashLatticeValue(aHash, aComp->rotateZ);
+      hashLatticeValue(aHash, aComp->centerPoint.x);
+      hashLatticeValue(aHash, aComp->centerPoint.y);
+      hashLatticeValue(aHash, aComp->centerPoint.z);
+    }
+  return aHash;
+}
+
+//Memory maps the LatticeFile and loads the compartmentalized lattice from
+//it. Returns false if the lattice must be constructed instead, i.e., when
+//there is no file or it was saved from a different geometry:
+bool SpatiocyteStepper::loadLattice()
+{
+  if(LatticeFile.empty())
+    {
+      return false;
+    }
+  const int aDescriptor(open(LatticeFile.c_str(), O_RDONLY));
+  if(aDescriptor == -1)
+    {
+      std::cout << "   Lattice file " << LatticeFile << " not found." <<
+        std::endl;
+      return false;
+    }
+  struct stat aStat;
+  void* aMap(MAP_FAILED);
+  if(fstat(aDescriptor, &aStat) == 0 && aStat.st_size > 0)
+    {
+      aMap = mmap(NULL, aStat.st_size, PROT_READ, MAP_PRIVATE, aDescriptor, 0);
+    }
+  close(aDescriptor);
+  if(aMap == MAP_FAILED)
+    {
+      std::cout << "   Unable to map lattice file " << LatticeFile << "." <<
+        std::endl;
+      return false;
+    }
+  const char* aCursor(static_cast<const char*>(aMap));
+  const char* anEnd(aCursor+aStat.st_size);
+  const unsigned int aLatticeSize(theLattice.size());
+  unsigned int aVersion;
+  unsigned long long aHash;
+  unsigned int aSize;
+  unsigned int anAdjoiningVoxelSize;
+  unsigned int aCompSize;
+  bool isValid(size_t(anEnd-aCursor) > strlen(LATTICE_FILE_MAGIC) &&
+               !memcmp(aCursor, LATTICE_FILE_MAGIC, 
+                       strlen(LATTICE_FILE_MAGIC)));
+  if(isValid)
+    {
+      aCursor += strlen(LATTICE_FILE_MAGIC);
+    }
+  isValid = isValid && readLatticeValue(aCursor, anEnd, aVersion) &&
+    aVersion == LATTICE_FILE_VERSION &&
+    readLatticeValue(aCursor, anEnd, aHash) && aHash == getGeometryHash() &&
+    readLatticeValue(aCursor, anEnd, aSize) && aSize == aLatticeSize &&
+    readLatticeValue(aCursor, anEnd, anAdjoiningVoxelSize) &&
+    anAdjoiningVoxelSize == theAdjoiningVoxelSize &&
+    readLatticeValue(aCursor, anEnd, aCompSize) &&
+    aCompSize == theComps.size();
+  if(!isValid)
+    {
+      munmap(aMap, aStat.st_size);
+      std::cout << "   Lattice file " << LatticeFile << " was saved from a " <<
+        "different geometry." << std::endl;
+      return false;
+    }
+  //Voxel IDs and adjoiningSizes:
+  std::vector<unsigned short> adjoiningSizes;
+  isValid = readLatticeVector(aCursor, anEnd, theIDs, aLatticeSize) &&
+    readLatticeVector(aCursor, anEnd, adjoiningSizes, aLatticeSize);
+  for(unsigned int i(0); isValid && i != aLatticeSize; ++i)
+    {
+      theLattice[i].adjoiningSize = adjoiningSizes[i];
+    }
+  for(unsigned int i(0); isValid && i != theRowSize*theLayerSize*theColSize;
+      ++i)
+    {
+      theLattice[coord2index(theStartCoord+i)].coord = theStartCoord+i;
+    }
+  //Explicit adjoiningVoxels arrays. They are allocated in a single block
+  //and their voxel indices are converted directly from the mapped file:
+  std::vector<unsigned int> indices;
+  isValid = isValid && readLatticeValue(aCursor, anEnd, aSize) &&
+    size_t(anEnd-aCursor)/(sizeof(unsigned int)*(theAdjoiningVoxelSize+1)) >=
+    aSize;
+  if(isValid && aSize)
+    {
+      theLoadedAdjoiningVoxels = new Voxel*[aSize*theAdjoiningVoxelSize];
+    }
+  Voxel** adjoiningVoxels(theLoadedAdjoiningVoxels);
+  for(unsigned int i(0); isValid && i != aSize; ++i)
+    {
+      unsigned int anIndex;
+      isValid = readLatticeValue(aCursor, anEnd, anIndex) &&
+        anIndex < aLatticeSize && !theLattice[anIndex].adjoiningVoxels;
+      if(isValid)
+        {
+          theLattice[anIndex].adjoiningVoxels = adjoiningVoxels;
+          for(unsigned int j(0); isValid && j != theAdjoiningVoxelSize; ++j)
+            {
+              unsigned int anAdjoiningIndex;
+              isValid = readLatticeValue(aCursor, anEnd, anAdjoiningIndex) &&
+                anAdjoiningIndex < aLatticeSize;
+              adjoiningVoxels[j] = &theLattice[isValid ? anAdjoiningIndex :
+                                                          anIndex];
+            }
+          adjoiningVoxels += theAdjoiningVoxelSize;
+        }
+    }
+  //Surface voxel lists. Except for SHARED, all list types have the same
+  //number of lists, while there is a SHARED list for every EXTENDED voxel:
+  for(unsigned int i(0); isValid && i != SURFACE_LIST_SIZE; ++i)
+    {
+      std::vector<unsigned int>& offsets(theSurfaceVoxels.offsets[i]);
+      std::vector<Voxel*>& voxels(theSurfaceVoxels.voxels[i]);
+      isValid = readLatticeValue(aCursor, anEnd, aSize) &&
+        aSize >= (i == SHARED ? 1u : 2u) &&
+        readLatticeVector(aCursor, anEnd, offsets, aSize) && !offsets[0] &&
+        readLatticeValue(aCursor, anEnd, aSize) && offsets.back() == aSize &&
+        readLatticeVector(aCursor, anEnd, indices, aSize) &&
+        offsets.size() == (i == SHARED ? 
+                           theSurfaceVoxels.voxels[EXTENDED].size()+1 :
+                           theSurfaceVoxels.offsets[INNER].size());
+      for(unsigned int j(1); isValid && j < offsets.size(); ++j)
+        {
+          isValid = offsets[j-1] <= offsets[j];
+        }
+      voxels.clear();
+      for(unsigned int j(0); isValid && j != aSize; ++j)
+        {
+          isValid = indices[j] < aLatticeSize;
+          voxels.push_back(&theLattice[isValid ? indices[j] : 0]);
+        }
+    }
+  isValid = isValid && readLatticeValue(aCursor, anEnd, aSize);
+  for(unsigned int i(0); isValid && i != aSize; ++i)
+    {
+      unsigned int anIndex;
+      unsigned int aSurfaceIndex;
+      isValid = readLatticeValue(aCursor, anEnd, anIndex) &&
+        anIndex < aLatticeSize && !theLattice[anIndex].surfaceIndex &&
+        readLatticeValue(aCursor, anEnd, aSurfaceIndex) && aSurfaceIndex &&
+        aSurfaceIndex < theSurfaceVoxels.offsets[INNER].size()-1;
+      if(isValid)
+        {
+          theLattice[anIndex].surfaceIndex = aSurfaceIndex;
+        }
+    }
+  //The compartmentalized Comps:
+  std::vector<std::vector<unsigned int> > compCoords(aCompSize);
+  std::vector<int> diffusiveComps(aCompSize);
+  std::vector<unsigned int> compDimensions;
+  for(unsigned int i(0); isValid && i != aCompSize; ++i)
+    {
+      isValid = readLatticeValue(aCursor, anEnd, aSize) &&
+        aSize <= aLatticeSize &&
+        readLatticeVector(aCursor, anEnd, compCoords[i], aSize) &&
+        readLatticeValue(aCursor, anEnd, diffusiveComps[i]) &&
+        diffusiveComps[i] >= -1 && diffusiveComps[i] < int(aCompSize) &&
+        readLatticeVector(aCursor, anEnd, indices, 6);
+      for(unsigned int j(0); isValid && j != aSize; ++j)
+        {
+          isValid = compCoords[i][j] < aLatticeSize;
+        }
+      compDimensions.insert(compDimensions.end(), indices.begin(),
+                            indices.end());
+    }
+  isValid = isValid && aCursor == anEnd;
+  munmap(aMap, aStat.st_size);
+  if(!isValid)
+    {
+      clearLattice();
+      std::cout << "   Lattice file " << LatticeFile << " is corrupted." <<
+        std::endl;
+      return false;
+    }
+  for(unsigned int i(0); i != aCompSize; ++i)
+    {
+      Comp* aComp(theComps[i]);
+      aComp->coords.swap(compCoords[i]);
+      aComp->diffusiveComp = NULL;
+      if(diffusiveComps[i] != -1)
+        {
+          aComp->diffusiveComp = theComps[diffusiveComps[i]];
+        }
+      aComp->minRow = compDimensions[i*6];
+      aComp->maxRow = compDimensions[i*6+1];
+      aComp->minLayer = compDimensions[i*6+2];
+      aComp->maxLayer = compDimensions[i*6+3];
+      aComp->minCol = compDimensions[i*6+4];
+      aComp->maxCol = compDimensions[i*6+5];
+    }
+  std::cout << "   Loaded lattice from " << LatticeFile << "." << std::endl;
+  return true;
+}
+
+//Writes the compartmentalized lattice to LatticeFile so that the next run
+//with the same geometry can load it instead. The file is written under a
+//temporary name first, so that a concurrent run never maps a partial file:
+void SpatiocyteStepper::saveLattice()
+{
+  if(LatticeFile.empty())
+    {
+      return;
+    }
+  const String aTempFile(LatticeFile + ".tmp");
+  std::ofstream aFile(aTempFile.c_str(), std::ios::binary | std::ios::trunc);
+  const unsigned int aLatticeSize(theLattice.size());
+  const Voxel* aFirstVoxel(&theLattice[0]);
+  const Voxel* anEndVoxel(aFirstVoxel+aLatticeSize);
+  aFile.write(LATTICE_FILE_MAGIC, strlen(LATTICE_FILE_MAGIC));
+  writeLatticeValue(aFile, (unsigned int)LATTICE_FILE_VERSION);
+  writeLatticeValue(aFile, getGeometryHash());
+  writeLatticeValue(aFile, aLatticeSize);
+  writeLatticeValue(aFile, theAdjoiningVoxelSize);
+  writeLatticeValue(aFile, (unsigned int)theComps.size());
+  writeLatticeVector(aFile, theIDs);
+  unsigned int anAdjoiningSize(0);
+  unsigned int aSurfaceSize(0);
+  for(unsigned int i(0); i != aLatticeSize; ++i)
+    {
+      writeLatticeValue(aFile, theLattice[i].adjoiningSize);
+      anAdjoiningSize += (theLattice[i].adjoiningVoxels != NULL);
+      aSurfaceSize += (theLattice[i].surfaceIndex != 0);
+    }
+  writeLatticeValue(aFile, anAdjoiningSize);
+  for(unsigned int i(0); i != aLatticeSize; ++i)
     {
-      for(unsigned int j(0); j!=theAdjoiningVoxelSize; ++j)
+      Voxel** adjoiningVoxels(theLattice[i].adjoiningVoxels);
+      if(adjoiningVoxels)
         {
-          if(aSrcVoxel->adjoiningVoxels[j] == aSrcVoxel)
+          writeLatticeValue(aFile, i);
+          for(unsigned int j(0); j != theAdjoiningVoxelSize; ++j)
             {
-              for(unsigned int k(0); k!=theAdjoiningVoxelSize; ++k)
+              //The arrays of the null voxels that were never concatenated
+              //are not initialized, so we let them point to the voxel
+              //itself:
+              unsigned int anIndex(i);
+              if(adjoiningVoxels[j] >= aFirstVoxel &&
+                 adjoiningVoxels[j] < anEndVoxel)
                 {
-                  if(aDestVoxel->adjoiningVoxels[j]->adjoiningVoxels[k] ==
-                     aDestVoxel)
-                    {
-                      aDestVoxel->adjoiningVoxels[j]->adjoiningVoxels[k] =
-                        aSrcVoxel;
-                    }
+                  anIndex = adjoiningVoxels[j]-aFirstVoxel;
                 }
+              writeLatticeValue(aFile, anIndex);
             }
         }
-      aDestVoxel->id = theNullID;
     }
+  for(unsigned int i(0); i != SURFACE_LIST_SIZE; ++i)
+    {
+      std::vector<unsigned int>& offsets(theSurfaceVoxels.offsets[i]);
+      std::vector<Voxel*>& voxels(theSurfaceVoxels.voxels[i]);
+      writeLatticeValue(aFile, (unsigned int)offsets.size());
+      writeLatticeVector(aFile, offsets);
+      writeLatticeValue(aFile, (unsigned int)voxels.size());
+      for(unsigned int j(0); j != voxels.size(); ++j)
+        {
+          writeLatticeValue(aFile, (unsigned int)(voxels[j]-aFirstVoxel));
+        }
+    }
+  writeLatticeValue(aFile, aSurfaceSize);
+  for(unsigned int i(0); i != aLatticeSize; ++i)
+    {
+      if(theLattice[i].surfaceIndex)
+        {
+          writeLatticeValue(aFile, i);
+          writeLatticeValue(aFile, theLattice[i].surfaceIndex);
+        }
+    }
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      Comp* aComp(*i);
+      writeLatticeValue(aFile, (unsigned int)aComp->coords.size());
+      writeLatticeVector(aFile, aComp->coords);
+      int aDiffusiveComp(-1);
+      if(aComp->diffusiveComp)
+        {
+          aDiffusiveComp = std::find(theComps.begin(), theComps.end(),
+                               aComp->diffusiveComp)-theComps.begin();
+        }
+      writeLatticeValue(aFile, aDiffusiveComp);
+      writeLatticeValue(aFile, aComp->minRow);
+      writeLatticeValue(aFile, aComp->maxRow);
+      writeLatticeValue(aFile, aComp->minLayer);
+      writeLatticeValue(aFile, aComp->maxLayer);
+      writeLatticeValue(aFile, aComp->minCol);
+      writeLatticeValue(aFile, aComp->maxCol);
+    }
+  aFile.close();
+  if(!aFile || rename(aTempFile.c_str(), LatticeFile.c_str()))
+    {
+      remove(aTempFile.c_str());
+      std::cout << "   Unable to save lattice to " << LatticeFile << "." <<
+        std::endl;
+      return;
+    }
+  std::cout << "   Saved lattice to " << LatticeFile << "." << std::endl;
 }
 
-void SpatiocyteStepper::shuffleAdjoiningVoxels()
+//Frees the arrays allocated by a lattice file that could not be loaded
+//completely:
+void SpatiocyteStepper::clearLattice()
 {
-  for(std::vector<Voxel>::iterator i(theLattice.begin()); i != theLattice.end(); ++i)
+  delete[] theLoadedAdjoiningVoxels;
+  theLoadedAdjoiningVoxels = NULL;
+  for(std::vector<Voxel>::iterator i(theLattice.begin());
+      i != theLattice.end(); ++i)
     {
-      if((*i).id != theNullID)
-        { 
-          gsl_ran_shuffle(getRng(), (*i).adjoiningVoxels, theAdjoiningVoxelSize,
-                          sizeof(Voxel*));
-        }
+      (*i).adjoiningVoxels = NULL;
+      (*i).surfaceIndex = 0;
+      (*i).adjoiningSize = 0;
     }
+  initSurfaceVoxels();
 }
 
-void SpatiocyteStepper::setCompVoxelProperties()
+//The IDs, adjoining voxels and coords of a loaded lattice are already
+//compartmentalized, but the subunits of the surface voxels are not saved:
+void SpatiocyteStepper::setLoadedCompVoxelProperties()
 {
   for(std::vector<Comp*>::iterator i(theComps.begin());
       i != theComps.end(); ++i)
     {
-      switch ((*i)->dimension)
+      if((*i)->dimension != 3 && !(*i)->diffusiveComp)
         {
-        case 1:
-          setLineCompProperties(*i);
-          setLineVoxelProperties(*i);
-          break;
-        case 2:
-          setSurfaceCompProperties(*i);
-          setSurfaceVoxelProperties(*i);
-          break;
-        case 3:
-        default:
-            setVolumeCompProperties(*i);
+          for(std::vector<unsigned int>::iterator j((*i)->coords.begin());
+              j != (*i)->coords.end(); ++j)
+            {
+              setSurfaceSubunit(&theLattice[*j], *i);
+            }
         }
     }
+  initVacantVoxels();
 }
 
 void SpatiocyteStepper::setLineCompProperties(Comp* aComp)
@@ -1893,17 +3267,55 @@ void SpatiocyteStepper::setVolumeCompProperties(Comp* aComp)
   setDiffusiveComp(aComp);
 }
 
+//The surface voxel lists found by each thread are appended to
+//theSurfaceVoxels in the thread order, which is also the order of the
+//surfaceIndex of the voxels:
 void SpatiocyteStepper::setSurfaceVoxelProperties(Comp* aComp)
 {
   if(!aComp->diffusiveComp)
     {
-      for(std::vector<unsigned int>::iterator i(aComp->coords.begin());
-          i != aComp->coords.end(); ++i)
+      theSurfaceChunks.resize(ThreadSize);
+      std::pair<SpatiocyteStepper*, Comp*> anArgument(this, aComp);
+      runThreads(&SpatiocyteStepper::setSurfaceVoxels, &anArgument);
+      for(unsigned int i(0); i != ThreadSize; ++i)
         {
-          Voxel* aVoxel(&theLattice[*i]);
-          optimizeSurfaceVoxel(aVoxel, aComp);
-          setSurfaceSubunit(aVoxel, aComp);
+          addSurfaceVoxels(theSurfaceChunks[i]);
         }
+      theSurfaceChunks.clear();
+    }
+}
+
+void SpatiocyteStepper::setSurfaceVoxels(void* anArgument, unsigned int aThread)
+{
+  std::pair<SpatiocyteStepper*, Comp*>* aPair(
+     static_cast<std::pair<SpatiocyteStepper*, Comp*>*>(anArgument));
+  aPair->first->setSurfaceVoxels(aPair->second, aThread);
+}
+
+//Each thread optimizes a contiguous part of the coords of aComp. The
+//extended surface voxels of a voxel depend on the reordered adjoining
+//voxels of its neighbours, so all threads must first complete the
+//immediate surface voxels:
+void SpatiocyteStepper::setSurfaceVoxels(Comp* aComp, unsigned int aThread)
+{
+  unsigned int aBegin;
+  unsigned int anEnd;
+  getThreadRange(aComp->coords.size(), aThread, &aBegin, &anEnd);
+  SurfaceVoxels& aChunk(theSurfaceChunks[aThread]);
+  clearSurfaceVoxels(aChunk);
+  const unsigned int aFirstIndex(theSurfaceVoxels.offsets[IMMEDIATE].size()-1);
+  for(unsigned int i(aBegin); i != anEnd; ++i)
+    {
+      Voxel* aVoxel(&theLattice[aComp->coords[i]]);
+      aVoxel->surfaceIndex = aFirstIndex+i;
+      setImmediateSurfaceVoxels(aVoxel, aComp, aChunk);
+      setSurfaceSubunit(aVoxel, aComp);
+    }
+  waitThreads();
+  for(unsigned int i(aBegin); i != anEnd; ++i)
+    {
+      setExtendedSurfaceVoxels(&theLattice[aComp->coords[i]], aComp, aChunk,
+                               i-aBegin);
     }
 }
 
@@ -1927,8 +3339,8 @@ void SpatiocyteStepper::setDiffusiveComp(Comp* aComp)
           j != aComp->coords.end(); ++j)
         {
           Voxel* aVoxel(&theLattice[*j]);
-          aVoxel->id = aComp->diffusiveComp->vacantID;
-          aComp->diffusiveComp->coords.push_back( aVoxel->coord-theStartCoord);
+          setID(aVoxel, aComp->diffusiveComp->vacantID);
+          aComp->diffusiveComp->coords.push_back(aVoxel-&theLattice[0]);
         }
       aComp->coords.clear();
     }
@@ -1946,7 +3358,7 @@ void SpatiocyteStepper::removePeriodicEdgeVoxels(Comp* aComp)
           Voxel* aVoxel(&theLattice[*j]);
           if(isPeriodicEdgeCoord(aVoxel->coord, aComp))
             {
-              aVoxel->id = theNullID;
+              setID(aVoxel, theNullID);
             }
           else
             {
@@ -1967,7 +3379,7 @@ void SpatiocyteStepper::removeSurfaces(Comp* aComp)
       if(isRemovableEdgeCoord(aVoxel->coord, aComp))
         { 
           Comp* aSuperComp(system2Comp(aComp->system->getSuperSystem())); 
-          aVoxel->id = aSuperComp->vacantID;
+          setID(aVoxel, aSuperComp->vacantID);
           aSuperComp->coords.push_back(*j);
         }
       else
@@ -1978,17 +3390,73 @@ void SpatiocyteStepper::removeSurfaces(Comp* aComp)
   aComp->coords = coords;
 }
 
+//The new surface voxel lists of aVoxel are appended to theSurfaceVoxels.
+//Any earlier lists of aVoxel are left unused:
 void SpatiocyteStepper::optimizeSurfaceVoxel(Voxel* aVoxel,
                                              Comp* aComp)
 {
-  unsigned short surfaceID(aComp->vacantID);
-  aVoxel->surfaceVoxels = new std::vector<std::vector<Voxel*> >;
-  aVoxel->surfaceVoxels->resize(4);
-  std::vector<Voxel*>& immediateSurface((*aVoxel->surfaceVoxels)[IMMEDIATE]);
-  std::vector<Voxel*>& extendedSurface((*aVoxel->surfaceVoxels)[EXTENDED]);
-  std::vector<Voxel*>& innerVolume((*aVoxel->surfaceVoxels)[INNER]);
-  std::vector<Voxel*>& outerVolume((*aVoxel->surfaceVoxels)[OUTER]);
-  std::vector<std::vector<Voxel*> > sharedVoxelsList;
+  SurfaceVoxels aChunk;
+  clearSurfaceVoxels(aChunk);
+  aVoxel->surfaceIndex = theSurfaceVoxels.offsets[IMMEDIATE].size()-1;
+  setImmediateSurfaceVoxels(aVoxel, aComp, aChunk);
+  setExtendedSurfaceVoxels(aVoxel, aComp, aChunk, 0);
+  addSurfaceVoxels(aChunk);
+}
+
+//Resets theSurfaceVoxels so that it only contains the empty lists of
+//surfaceIndex 0, the index of all voxels that are not surface voxels:
+void SpatiocyteStepper::initSurfaceVoxels()
+{
+  clearSurfaceVoxels(theSurfaceVoxels);
+  for(unsigned int i(0); i != SHARED; ++i)
+    {
+      theSurfaceVoxels.offsets[i].push_back(0);
+    }
+}
+
+void SpatiocyteStepper::clearSurfaceVoxels(SurfaceVoxels& aSurfaceVoxels)
+{
+  for(unsigned int i(0); i != SURFACE_LIST_SIZE; ++i)
+    {
+      aSurfaceVoxels.offsets[i].assign(1, 0);
+      aSurfaceVoxels.voxels[i].clear();
+    }
+}
+
+//Appends the lists of aChunk, whose offsets start from 0, to
+//theSurfaceVoxels:
+void SpatiocyteStepper::addSurfaceVoxels(SurfaceVoxels& aChunk)
+{
+  for(unsigned int i(0); i != SURFACE_LIST_SIZE; ++i)
+    {
+      std::vector<unsigned int>& offsets(theSurfaceVoxels.offsets[i]);
+      std::vector<Voxel*>& voxels(theSurfaceVoxels.voxels[i]);
+      const unsigned int aShift(voxels.size());
+      for(unsigned int j(1); j < aChunk.offsets[i].size(); ++j)
+        {
+          offsets.push_back(aShift+aChunk.offsets[i][j]);
+        }
+      voxels.insert(voxels.end(), aChunk.voxels[i].begin(),
+                    aChunk.voxels[i].end());
+    }
+}
+
+//Only the adjoiningVoxels array of aVoxel itself is modified here, so the
+//surface voxels of a Comp can be set up by several threads at once, each
+//with its own aChunk:
+void SpatiocyteStepper::setImmediateSurfaceVoxels(Voxel* aVoxel,
+                                                  Comp* aComp,
+                                                  SurfaceVoxels& aChunk)
+{
+  std::vector<Voxel*>& immediateSurface(aChunk.voxels[IMMEDIATE]);
+  std::vector<Voxel*>& innerVolume(aChunk.voxels[INNER]);
+  std::vector<Voxel*>& outerVolume(aChunk.voxels[OUTER]);
+  //The adjoining voxels of a surface voxel are reordered below, so it
+  //always needs an explicit adjoiningVoxels array:
+  if(!aVoxel->adjoiningVoxels)
+    {
+      setAdjoiningVoxels(aVoxel);
+    }
   Voxel** forward(aVoxel->adjoiningVoxels);
   Voxel** reverse(forward+theAdjoiningVoxelSize);
   std::vector<Voxel*> adjoiningCopy;
@@ -2002,45 +3470,14 @@ void SpatiocyteStepper::optimizeSurfaceVoxel(Voxel* aVoxel,
   for(std::vector<Voxel*>::iterator l(adjoiningCopy.begin());
       l != adjoiningCopy.end(); ++l)
     {
-      if((*l) != aVoxel && (*l)->id != theNullID 
-         && id2Comp((*l)->id)->dimension <= aComp->dimension)
+      if((*l) != aVoxel && getID(*l) != theNullID 
+         && id2Comp(getID(*l))->dimension <= aComp->dimension)
         {
           (*forward) = (*l);
           ++forward;
           //immediateSurface contains all adjoining surface voxels except the 
           //source voxel, aVoxel:
           immediateSurface.push_back(*l);
-          for(unsigned int m(0); m != theAdjoiningVoxelSize; ++m)
-            {
-              //extendedSurface contains the adjoining surface voxels of
-              //adjoining surface voxels. They do not include the source voxel
-              //and its adjoining voxels:
-              Voxel* extendedVoxel((*l)->adjoiningVoxels[m]);
-              if(extendedVoxel->id == surfaceID && extendedVoxel != aVoxel &&
-                 std::find(adjoiningCopy.begin(), adjoiningCopy.end(),
-                      extendedVoxel) == adjoiningCopy.end())
-                {
-                  std::vector<Voxel*>::iterator n(std::find(extendedSurface.begin(),
-                        extendedSurface.end(), extendedVoxel));
-                  if(n == extendedSurface.end())
-                    {
-                      extendedSurface.push_back(extendedVoxel);
-                      //We require shared immediate voxel which
-                      //connects the extended voxel with the source voxel 
-                      //for polymerization. Create a new list of shared
-                      //immediate voxel each time a new extended voxel is added:
-                      std::vector<Voxel*> sharedVoxels;
-                      sharedVoxels.push_back(*l);
-                      sharedVoxelsList.push_back(sharedVoxels);
-                    }
-                  else
-                    {
-                      //An extended voxel may have multiple shared immediate
-                      //voxels, so we insert the additional ones in the list:
-                      sharedVoxelsList[n-extendedSurface.begin()].push_back(*l);
-                    }
-                }
-            }
         }
       else
         {
@@ -2061,12 +3498,412 @@ void SpatiocyteStepper::optimizeSurfaceVoxel(Voxel* aVoxel,
             }
         }
     } 
+  aVoxel->adjoiningSize = forward-aVoxel->adjoiningVoxels;
+  aChunk.offsets[IMMEDIATE].push_back(immediateSurface.size());
+  aChunk.offsets[INNER].push_back(innerVolume.size());
+  aChunk.offsets[OUTER].push_back(outerVolume.size());
+}
+
+//The extended surface voxels are found through the adjoiningVoxels arrays
+//of the immediate surface voxels, so they must only be set after the
+//immediate surface voxels of all voxels of the Comp. aChunkIndex is the
+//index of the lists of aVoxel in aChunk:
+void SpatiocyteStepper::setExtendedSurfaceVoxels(Voxel* aVoxel,
+                                                 Comp* aComp,
+                                                 SurfaceVoxels& aChunk,
+                                                 unsigned int aChunkIndex)
+{
+  unsigned short surfaceID(aComp->vacantID);
+  std::vector<Voxel*>::iterator immediateBegin(
+     aChunk.voxels[IMMEDIATE].begin()+aChunk.offsets[IMMEDIATE][aChunkIndex]);
+  std::vector<Voxel*>::iterator immediateEnd(
+     aChunk.voxels[IMMEDIATE].begin()+aChunk.offsets[IMMEDIATE][aChunkIndex+1]);
+  std::vector<Voxel*> extendedSurface;
+  std::vector<std::vector<Voxel*> > sharedVoxelsList;
+  Voxel** adjoiningBegin(aVoxel->adjoiningVoxels);
+  Voxel** adjoiningEnd(adjoiningBegin+theAdjoiningVoxelSize);
+  for(std::vector<Voxel*>::iterator l(immediateBegin); l != immediateEnd; ++l)
+    {
+      for(unsigned int m(0); m != theAdjoiningVoxelSize; ++m)
+        {
+          //extendedSurface contains the adjoining surface voxels of
+          //adjoining surface voxels. They do not include the source voxel
+          //and its adjoining voxels:
+          Voxel* extendedVoxel(getAdjoiningVoxel(*l, m));
+          if(getID(extendedVoxel) == surfaceID &&
+             extendedVoxel != aVoxel &&
+             std::find(adjoiningBegin, adjoiningEnd,
+                       extendedVoxel) == adjoiningEnd)
+            {
+              std::vector<Voxel*>::iterator n(std::find(extendedSurface.begin(),
+                    extendedSurface.end(), extendedVoxel));
+              if(n == extendedSurface.end())
+                {
+                  extendedSurface.push_back(extendedVoxel);
+                  //We require shared immediate voxel which
+                  //connects the extended voxel with the source voxel 
+                  //for polymerization. Create a new list of shared
+                  //immediate voxel each time a new extended voxel is added:
+                  std::vector<Voxel*> sharedVoxels;
+                  sharedVoxels.push_back(*l);
+                  sharedVoxelsList.push_back(sharedVoxels);
+                }
+              else
+                {
+                  //An extended voxel may have multiple shared immediate
+                  //voxels, so we insert the additional ones in the list:
+                  sharedVoxelsList[n-extendedSurface.begin()].push_back(*l);
+                }
+            }
+        }
+    }
+  aChunk.voxels[EXTENDED].insert(aChunk.voxels[EXTENDED].end(),
+                                 extendedSurface.begin(),
+                                 extendedSurface.end());
+  aChunk.offsets[EXTENDED].push_back(aChunk.voxels[EXTENDED].size());
   for(std::vector<std::vector<Voxel*> >::iterator i(sharedVoxelsList.begin());
       i != sharedVoxelsList.end(); ++i)
     {
-      aVoxel->surfaceVoxels->push_back(*i);
+      aChunk.voxels[SHARED].insert(aChunk.voxels[SHARED].end(), i->begin(),
+                                   i->end());
+      aChunk.offsets[SHARED].push_back(aChunk.voxels[SHARED].size());
     }
-  aVoxel->adjoiningSize = forward-aVoxel->adjoiningVoxels;
+}
+
+//Drops the surface voxel lists that are no longer used by any voxel, e.g.,
+//the old lists of the surface voxels of a grown Comp:
+void SpatiocyteStepper::compactSurfaceVoxels()
+{
+  SurfaceVoxels aChunk;
+  clearSurfaceVoxels(aChunk);
+  unsigned int aSurfaceIndex(1);
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      if((*i)->dimension == 3)
+        {
+          continue;
+        }
+      for(std::vector<unsigned int>::iterator j((*i)->coords.begin());
+          j != (*i)->coords.end(); ++j)
+        {
+          Voxel* aVoxel(&theLattice[*j]);
+          if(!aVoxel->surfaceIndex)
+            {
+              continue;
+            }
+          unsigned int aSize;
+          for(unsigned int k(0); k != SHARED; ++k)
+            {
+              Voxel** voxels(getSurfaceVoxels(aVoxel, k, aSize));
+              aChunk.voxels[k].insert(aChunk.voxels[k].end(), voxels,
+                                      voxels+aSize);
+              aChunk.offsets[k].push_back(aChunk.voxels[k].size());
+            }
+          unsigned int anExtendedSize;
+          getSurfaceVoxels(aVoxel, EXTENDED, anExtendedSize);
+          for(unsigned int k(0); k != anExtendedSize; ++k)
+            {
+              Voxel** voxels(getSharedVoxels(aVoxel, k, aSize));
+              aChunk.voxels[SHARED].insert(aChunk.voxels[SHARED].end(),
+                                           voxels, voxels+aSize);
+              aChunk.offsets[SHARED].push_back(aChunk.voxels[SHARED].size());
+            }
+          aVoxel->surfaceIndex = aSurfaceIndex++;
+        }
+    }
+  initSurfaceVoxels();
+  addSurfaceVoxels(aChunk);
+}
+
+//Grows aComp along the x axis (anAxis = 1) by inserting a slab of columns
+//at aCol. The lattice itself is not resized. Instead, the IDs and molecules
+//of aComp and its subComps in the columns from aCol to the east edge of
+//aComp are shifted east by the width of the slab, while the slab keeps the
+//compartments of the columns it was inserted at. Only the voxels of this
+//east part of aComp and those around it are updated:
+void SpatiocyteStepper::growCompartment(Comp* aComp, unsigned int anAxis,
+                                        unsigned int aCol)
+{
+  if(anAxis != 1)
+    {
+      THROW_EXCEPTION(ValueError, getPropertyInterface().getClassName() +
+                      ": a compartment can only be grown along the x " +
+                      "axis (Axis = 1).");
+    }
+  if(!aComp->surfaceSub)
+    {
+      THROW_EXCEPTION(ValueError, getPropertyInterface().getClassName() +
+                      ": " + aComp->system->getFullID().asString() +
+                      " has no surface compartment to grow.");
+    }
+  //The HCP lattice repeats every two columns:
+  const unsigned int aSlabSize(LatticeType == HCP_LATTICE ? 2 : 1);
+  if(aCol < aComp->minCol || aCol > aComp->maxCol ||
+     aComp->maxCol+aSlabSize+2 >= theColSize)
+    {
+      THROW_EXCEPTION(ValueError, getPropertyInterface().getClassName() +
+                      ": the lattice has no free columns to grow " +
+                      aComp->system->getFullID().asString() + ".");
+    }
+  std::vector<Comp*> growingComps(aComp->allSubs);
+  growingComps.push_back(aComp);
+  if(!isGrowingComp(aComp->surfaceSub, growingComps))
+    {
+      growingComps.push_back(aComp->surfaceSub);
+    }
+  const unsigned int aMinRow(aComp->minRow);
+  const unsigned int aMaxRow(aComp->maxRow);
+  const unsigned int aMinLayer(aComp->minLayer);
+  const unsigned int aMaxLayer(aComp->maxLayer);
+  const unsigned int aMaxCol(aComp->maxCol+aSlabSize);
+  std::vector<std::pair<Comp*, unsigned int> > removedCoords;
+  std::vector<Species*> displacedSpecies;
+  //We start from the east edge so that the source voxel of each shifted
+  //voxel is still unchanged when it is read:
+  for(unsigned int c(aMaxCol+1); c-- != aCol; )
+    {
+      for(unsigned int l(aMinLayer); l <= aMaxLayer; ++l)
+        {
+          for(unsigned int r(aMinRow); r <= aMaxRow; ++r)
+            {
+              const unsigned int anIndex(global2index(r, l, c));
+              Voxel* aVoxel(&theLattice[anIndex]);
+              const unsigned short anID(getID(aVoxel));
+              Comp* anOldComp(getOwnerComp(anID));
+              const bool isGrowing(isGrowingComp(anOldComp, growingComps));
+              //The molecules of the slab have already been shifted east:
+              if(c < aCol+aSlabSize)
+                {
+                  if(isGrowing && anID != anOldComp->vacantID)
+                    {
+                      setID(aVoxel, anOldComp->vacantID);
+                    }
+                  continue;
+                }
+              Voxel* aSource(&theLattice[global2index(r, l, c-aSlabSize)]);
+              const unsigned short aSourceID(getID(aSource));
+              Comp* aNewComp(getOwnerComp(aSourceID));
+              if(isGrowingComp(aNewComp, growingComps))
+                {
+                  //A molecule of an outer Comp in the way of the shifted
+                  //voxels is moved elsewhere in its Comp below:
+                  Species* aSpecies(id2species(anID));
+                  if(!isGrowing && anOldComp && !aSpecies->getIsVacant() &&
+                     !aSpecies->getIsDiffuseVacant())
+                    {
+                      aSpecies->softRemoveMolecule(aVoxel);
+                      displacedSpecies.push_back(aSpecies);
+                    }
+                  Species* aSourceSpecies(id2species(aSourceID));
+                  aSourceSpecies->softRemoveMolecule(aSource);
+                  aSourceSpecies->addMolecule(aVoxel);
+                }
+              else if(isGrowing)
+                {
+                  setID(aVoxel, aNewComp ? aNewComp->vacantID : theNullID);
+                }
+              else
+                {
+                  aNewComp = anOldComp;
+                }
+              if(aNewComp != anOldComp)
+                {
+                  if(anOldComp)
+                    {
+                      removedCoords.push_back(std::make_pair(anOldComp,
+                                                             anIndex));
+                    }
+                  if(aNewComp)
+                    {
+                      aNewComp->coords.push_back(anIndex);
+                    }
+                }
+            }
+        }
+    }
+  //Remove the voxels that changed their Comp from the coords of their old
+  //Comp, one Comp at a time:
+  std::sort(removedCoords.begin(), removedCoords.end());
+  for(unsigned int i(0); i != removedCoords.size(); )
+    {
+      Comp* anOldComp(removedCoords[i].first);
+      unsigned int anEnd(i);
+      while(anEnd != removedCoords.size() &&
+            removedCoords[anEnd].first == anOldComp)
+        {
+          ++anEnd;
+        }
+      std::vector<unsigned int> coords;
+      for(std::vector<unsigned int>::iterator j(anOldComp->coords.begin());
+          j != anOldComp->coords.end(); ++j)
+        {
+          if(!std::binary_search(removedCoords.begin()+i,
+                                 removedCoords.begin()+anEnd,
+                                 std::make_pair(anOldComp, *j)))
+            {
+              coords.push_back(*j);
+            }
+        }
+      anOldComp->coords.swap(coords);
+      i = anEnd;
+    }
+  //A displaced molecule is lost if its Comp has no vacant voxel left:
+  unsigned int aLostSize(0);
+  for(std::vector<Species*>::iterator i(displacedSpecies.begin());
+      i != displacedSpecies.end(); ++i)
+    {
+      Comp* aVacantComp(theVacantComps[(*i)->getVacantID()]);
+      if(aVacantComp && !aVacantComp->vacantVoxels.empty())
+        {
+          (*i)->addMolecule(aVacantComp->vacantVoxels[gsl_rng_uniform_int(
+                             getRng(), aVacantComp->vacantVoxels.size())]);
+        }
+      else
+        {
+          std::cout << "   Growing " << aComp->system->getFullID().asString()
+            << " removed a molecule of " <<
+            (*i)->getVariable()->getFullID().asString() <<
+            " that had no vacant voxel left." << std::endl;
+          ++aLostSize;
+        }
+    }
+  if(aLostSize)
+    {
+      std::cout << "   Growing " << aComp->system->getFullID().asString() <<
+        " removed " << aLostSize << " molecules in total." << std::endl;
+    }
+  for(std::vector<Comp*>::iterator i(growingComps.begin());
+      i != growingComps.end(); ++i)
+    {
+      growCompGeometry(*i, aCol, aSlabSize);
+    }
+  setGrownSurfaceVoxels(aMinRow, aMaxRow, aMinLayer, aMaxLayer,
+                        aCol+aSlabSize, aMaxCol);
+  setCompActualSizes();
+}
+
+//Shifts aComp east by the width of the inserted slab if it lies east of
+//aCol, or stretches it if it spans aCol:
+void SpatiocyteStepper::growCompGeometry(Comp* aComp, unsigned int aCol,
+                                         unsigned int aSlabSize)
+{
+  const double aColWidth(LatticeType == HCP_LATTICE ? theHCPh :
+                         2*theNormalizedVoxelRadius);
+  const double aSlabX(aCol*aColWidth);
+  const double aSlabWidth(aSlabSize*aColWidth);
+  if(aComp->centerPoint.x-aComp->lengthX/2 >= aSlabX)
+    {
+      aComp->centerPoint.x += aSlabWidth;
+    }
+  else if(aComp->centerPoint.x+aComp->lengthX/2 >= aSlabX)
+    {
+      aComp->lengthX += aSlabWidth;
+      aComp->centerPoint.x += aSlabWidth/2;
+    }
+  //Only Comps with a surface have their dimensions set:
+  if(aComp->minCol != UINT_MAX)
+    {
+      if(aComp->minCol >= aCol)
+        {
+          aComp->minCol += aSlabSize;
+        }
+      if(aComp->maxCol >= aCol)
+        {
+          aComp->maxCol += aSlabSize;
+        }
+    }
+}
+
+//Sets the surface voxels again after the IDs in the given rows, layers and
+//columns have been changed by growCompartment. The extended surface voxels
+//of the surface voxels up to two voxels away from the changed voxels may
+//also have changed, so they are set again as well:
+void SpatiocyteStepper::setGrownSurfaceVoxels(unsigned int aMinRow,
+                                              unsigned int aMaxRow,
+                                              unsigned int aMinLayer,
+                                              unsigned int aMaxLayer,
+                                              unsigned int aMinCol,
+                                              unsigned int aMaxCol)
+{
+  std::vector<Voxel*> surfaceVoxels;
+  std::vector<Comp*> surfaceComps;
+  for(unsigned int c(aMinCol > 2 ? aMinCol-2 : 0);
+      c <= std::min(aMaxCol+2, theColSize-1); ++c)
+    {
+      for(unsigned int l(aMinLayer > 2 ? aMinLayer-2 : 0);
+          l <= std::min(aMaxLayer+2, theLayerSize-1); ++l)
+        {
+          for(unsigned int r(aMinRow > 2 ? aMinRow-2 : 0);
+              r <= std::min(aMaxRow+2, theRowSize-1); ++r)
+            {
+              Voxel* aVoxel(&theLattice[global2index(r, l, c)]);
+              //Restore the unordered adjoining voxels of the old surface
+              //voxels:
+              if(aVoxel->surfaceIndex)
+                {
+                  setAdjoiningVoxels(aVoxel);
+                  aVoxel->adjoiningSize = theAdjoiningVoxelSize;
+                  aVoxel->surfaceIndex = 0;
+                  delete aVoxel->subunit;
+                  aVoxel->subunit = NULL;
+                }
+              Comp* aComp(getOwnerComp(getID(aVoxel)));
+              if(aComp && aComp->dimension != 3)
+                {
+                  surfaceVoxels.push_back(aVoxel);
+                  surfaceComps.push_back(aComp);
+                }
+            }
+        }
+    }
+  SurfaceVoxels aChunk;
+  clearSurfaceVoxels(aChunk);
+  const unsigned int aFirstIndex(theSurfaceVoxels.offsets[IMMEDIATE].size()-1);
+  for(unsigned int i(0); i != surfaceVoxels.size(); ++i)
+    {
+      surfaceVoxels[i]->surfaceIndex = aFirstIndex+i;
+      setImmediateSurfaceVoxels(surfaceVoxels[i], surfaceComps[i], aChunk);
+      setSurfaceSubunit(surfaceVoxels[i], surfaceComps[i]);
+    }
+  for(unsigned int i(0); i != surfaceVoxels.size(); ++i)
+    {
+      setExtendedSurfaceVoxels(surfaceVoxels[i], surfaceComps[i], aChunk, i);
+    }
+  addSurfaceVoxels(aChunk);
+  //Drop the old lists once they take up most of theSurfaceVoxels:
+  unsigned int aSurfaceSize(0);
+  for(std::vector<Comp*>::iterator i(theComps.begin());
+      i != theComps.end(); ++i)
+    {
+      if((*i)->dimension != 3)
+        {
+          aSurfaceSize += (*i)->coords.size();
+        }
+    }
+  if(theSurfaceVoxels.offsets[IMMEDIATE].size() > 2*(aSurfaceSize+1))
+    {
+      compactSurfaceVoxels();
+    }
+}
+
+//The Comp whose coords contain the voxels with anID. The voxels of a Comp
+//with a diffusiveComp belong to the diffusiveComp:
+Comp* SpatiocyteStepper::getOwnerComp(unsigned short anID)
+{
+  Comp* aComp(id2Comp(anID));
+  if(aComp && aComp->diffusiveComp)
+    {
+      return aComp->diffusiveComp;
+    }
+  return aComp;
+}
+
+bool SpatiocyteStepper::isGrowingComp(Comp* aComp,
+                                      std::vector<Comp*> const& growingComps)
+{
+  return aComp && std::find(growingComps.begin(), growingComps.end(),
+                            aComp) != growingComps.end();
 }
 
 Species* SpatiocyteStepper::id2species(unsigned short id)
@@ -2084,6 +3921,19 @@ Voxel* SpatiocyteStepper::coord2voxel(unsigned int aCoord)
   return &theLattice[aCoord];
 }
 
+unsigned int SpatiocyteStepper::coord2index(unsigned int aCoord)
+{
+  if(LatticeOrder == ROW_MAJOR_ORDER)
+    {
+      return aCoord-theStartCoord;
+    }
+  unsigned int aRow;
+  unsigned int aLayer;
+  unsigned int aCol;
+  coord2global(aCoord, &aRow, &aLayer, &aCol);
+  return global2index(aRow, aLayer, aCol);
+}
+
 Comp* SpatiocyteStepper::system2Comp(System* aSystem)
 {
   for(unsigned int i(0); i != theComps.size(); ++i)
@@ -2216,19 +4066,68 @@ void SpatiocyteStepper::setIntersectingParent()
     }
 }
 
+//Each thread compartmentalizes the voxels of its own range of columns into
+//a LatticeChunk. The chunks are then added to the Comps in the order of the
+//threads, so the coords of every Comp are sorted just as they would be in a
+//single thread. The IDs of the voxels are only set from the chunks because
+//compartmentalizeVoxel reads the IDs of the adjoining voxels:
 void SpatiocyteStepper::compartmentalizeLattice() 
 {
-  for(std::vector<Voxel>::iterator i(theLattice.begin());
-      i != theLattice.end(); ++i)
+  theLatticeChunks.resize(ThreadSize);
+  for(unsigned int i(0); i != ThreadSize; ++i)
+    {
+      theLatticeChunks[i].coords.resize(theSpecies.size());
+    }
+  runThreads(&SpatiocyteStepper::compartmentalizeVoxels, this);
+  for(unsigned int i(0); i != ThreadSize; ++i)
+    {
+      LatticeChunk& aChunk(theLatticeChunks[i]);
+      for(std::vector<Comp*>::iterator j(theComps.begin());
+          j != theComps.end(); ++j)
+        {
+          std::vector<unsigned int>& coords(aChunk.coords[(*j)->vacantID]);
+          for(std::vector<unsigned int>::iterator k(coords.begin());
+              k != coords.end(); ++k)
+            {
+              setID(&theLattice[*k], (*j)->vacantID);
+            }
+          (*j)->coords.insert((*j)->coords.end(), coords.begin(),
+                              coords.end());
+        }
+      for(std::vector<std::pair<Comp*, unsigned int> >::iterator j(
+          aChunk.surfaceCoords.begin()); j != aChunk.surfaceCoords.end(); ++j)
+        {
+          setMinMaxSurfaceDimensions(j->second, j->first);
+        }
+    }
+  theLatticeChunks.clear();
+}
+
+void SpatiocyteStepper::compartmentalizeVoxels(void* aStepper,
+                                               unsigned int aThread)
+{
+  static_cast<SpatiocyteStepper*>(aStepper)->compartmentalizeVoxels(aThread);
+}
+
+void SpatiocyteStepper::compartmentalizeVoxels(unsigned int aThread)
+{
+  LatticeChunk& aChunk(theLatticeChunks[aThread]);
+  unsigned int aBegin;
+  unsigned int anEnd;
+  getThreadRange(theColSize, aThread, &aBegin, &anEnd);
+  for(unsigned int i(aBegin*theRowSize*theLayerSize);
+      i != anEnd*theRowSize*theLayerSize; ++i)
     {
-      if((*i).id != theNullID)
+      const unsigned int anIndex(coord2index(theStartCoord+i));
+      if(theIDs[anIndex] != theNullID)
         { 
-          compartmentalizeVoxel(&(*i), theComps[0]);
+          compartmentalizeVoxel(&theLattice[anIndex], theComps[0], aChunk);
         }
     }
 }
 
-bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
+bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp,
+                                              LatticeChunk& aChunk)
 {
   if(aComp->dimension == 3)
     {
@@ -2250,10 +4149,10 @@ bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
                   //a future surface voxel)
                   if(isEnclosedSurfaceVoxel(aVoxel, aComp))
                     {
-                      aVoxel->id = aComp->surfaceSub->vacantID;
-                      aComp->surfaceSub->coords.push_back(
-                                                 aVoxel->coord-theStartCoord);
-                      setMinMaxSurfaceDimensions(aVoxel->coord, aComp);
+                      aChunk.coords[aComp->surfaceSub->vacantID].push_back(
+                                                 aVoxel-&theLattice[0]);
+                      aChunk.surfaceCoords.push_back(
+                                         std::make_pair(aComp, aVoxel->coord));
                       return true;
                     }
                 }
@@ -2270,10 +4169,10 @@ bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
               if(aComp->surfaceSub && 
                  isEnclosedRootSurfaceVoxel(aVoxel, aComp, aRootComp))
                 {
-                  aVoxel->id = aComp->surfaceSub->vacantID;
-                  aComp->surfaceSub->coords.push_back(
-                                                aVoxel->coord-theStartCoord);
-                  setMinMaxSurfaceDimensions(aVoxel->coord, aComp);
+                  aChunk.coords[aComp->surfaceSub->vacantID].push_back(
+                                                aVoxel-&theLattice[0]);
+                  aChunk.surfaceCoords.push_back(
+                                         std::make_pair(aComp, aVoxel->coord));
                   return true;
                 }
             }
@@ -2283,22 +4182,23 @@ bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
               if(aComp->surfaceSub && aComp->surfaceSub->enclosed &&
                  isParentSurfaceVoxel(aVoxel, aParentComp))
                 {
-                  aVoxel->id = aComp->surfaceSub->vacantID;
-                  aComp->surfaceSub->coords.push_back(
-                                                aVoxel->coord-theStartCoord);
-                  setMinMaxSurfaceDimensions(aVoxel->coord, aComp);
+                  aChunk.coords[aComp->surfaceSub->vacantID].push_back(
+                                                aVoxel-&theLattice[0]);
+                  aChunk.surfaceCoords.push_back(
+                                         std::make_pair(aComp, aVoxel->coord));
                   return true;
                 }
             }
           for(unsigned int i(0); i != aComp->immediateSubs.size(); ++i)
             {
-              if(compartmentalizeVoxel(aVoxel, aComp->immediateSubs[i]))
+              if(compartmentalizeVoxel(aVoxel, aComp->immediateSubs[i],
+                                      aChunk))
                 {
                   return true;
                 }
             }
-          aVoxel->id = aComp->vacantID;
-          aComp->coords.push_back(aVoxel->coord-theStartCoord);
+          aChunk.coords[aComp->vacantID].push_back(
+                                                aVoxel-&theLattice[0]);
           return true;
         }
       if(aComp->surfaceSub)
@@ -2306,10 +4206,10 @@ bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
           if(isInsideCoord(aVoxel->coord, aComp, 4) &&
              isSurfaceVoxel(aVoxel, aComp))
             {
-              aVoxel->id = aComp->surfaceSub->vacantID;
-              aComp->surfaceSub->coords.push_back(
-                                              aVoxel->coord-theStartCoord);
-              setMinMaxSurfaceDimensions(aVoxel->coord, aComp);
+              aChunk.coords[aComp->surfaceSub->vacantID].push_back(
+                                              aVoxel-&theLattice[0]);
+              aChunk.surfaceCoords.push_back(
+                                         std::make_pair(aComp, aVoxel->coord));
               return true;
             }
         }
@@ -2320,9 +4220,10 @@ bool SpatiocyteStepper::compartmentalizeVoxel(Voxel* aVoxel, Comp* aComp)
       if(!isInsideCoord(aVoxel->coord, aRootComp, -4) &&
          isRootSurfaceVoxel(aVoxel, aRootComp))
         {
-          aVoxel->id = aComp->vacantID;
-          aComp->coords.push_back(aVoxel->coord-theStartCoord);
-          setMinMaxSurfaceDimensions(aVoxel->coord, aRootComp);
+          aChunk.coords[aComp->vacantID].push_back(
+                                                aVoxel-&theLattice[0]);
+          aChunk.surfaceCoords.push_back(
+                                     std::make_pair(aRootComp, aVoxel->coord));
           return true;
         }
     }
@@ -2333,8 +4234,8 @@ bool SpatiocyteStepper::isRootSurfaceVoxel(Voxel* aVoxel, Comp* aComp)
 {
   for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
     {
-      if(aVoxel->adjoiningVoxels[i]->id == theNullID ||
-         aVoxel->adjoiningVoxels[i] == aVoxel)
+      if(getID(getAdjoiningVoxel(aVoxel, i)) == theNullID ||
+         getAdjoiningVoxel(aVoxel, i) == aVoxel)
         {
           return true;
         }
@@ -2348,7 +4249,7 @@ bool SpatiocyteStepper::isParentSurfaceVoxel(Voxel* aVoxel, Comp* aComp)
     {
       for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
         {
-          if(!isInsideCoord(aVoxel->adjoiningVoxels[i]->coord, aComp, 0))
+          if(!isInsideCoord(getAdjoiningVoxel(aVoxel, i)->coord, aComp, 0))
             {
               return true;
             }
@@ -2376,7 +4277,7 @@ bool SpatiocyteStepper::isEnclosedRootSurfaceVoxel(Voxel* aVoxel, Comp* aComp,
             {
               for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
                 {
-                  if(isRootSurfaceVoxel(aVoxel->adjoiningVoxels[i], aComp))
+                  if(isRootSurfaceVoxel(getAdjoiningVoxel(aVoxel, i), aComp))
                     {
                       return true;
                     }
@@ -2409,7 +4310,7 @@ bool SpatiocyteStepper::isSurfaceVoxel(Voxel* aVoxel, Comp* aComp)
     }
   for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
     {
-      if(isInsideCoord(aVoxel->adjoiningVoxels[i]->coord, aComp, 0))
+      if(isInsideCoord(getAdjoiningVoxel(aVoxel, i)->coord, aComp, 0))
         {
           return true;
         }
@@ -2421,7 +4322,7 @@ bool SpatiocyteStepper::isEnclosedSurfaceVoxel(Voxel* aVoxel, Comp* aComp)
 {
   for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
     {
-      if(isPeerVoxel(aVoxel->adjoiningVoxels[i], aComp))
+      if(isPeerVoxel(getAdjoiningVoxel(aVoxel, i), aComp))
         {
           return true;
         }
@@ -2464,7 +4365,7 @@ bool SpatiocyteStepper::isPeerVoxel(Voxel* aVoxel, Comp* aComp)
             {
               for(unsigned int j(0); j != theAdjoiningVoxelSize; ++j)
                 {
-                  if(isInsideCoord(aVoxel->adjoiningVoxels[j]->coord, *i, 0))
+                  if(isInsideCoord(getAdjoiningVoxel(aVoxel, j)->coord, *i, 0))
                     {
                       return true;
                     }
@@ -2488,7 +4389,7 @@ bool SpatiocyteStepper::isLineVoxel(Voxel* aVoxel, Comp* aComp)
         // aligned yet.
         for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
         {
-            const Voxel* adjoiningVoxel(aVoxel->adjoiningVoxels[i]);
+            const Voxel* adjoiningVoxel(getAdjoiningVoxel(aVoxel, i));
             const Point adjoiningPoint(coord2point(adjoiningVoxel->coord));
             const double distance_i(adjoiningPoint.x - aComp->centerPoint.x);
             if (distance_i > 0)
@@ -2506,7 +4407,7 @@ bool SpatiocyteStepper::isLineVoxel(Voxel* aVoxel, Comp* aComp)
         // aligned yet.
         for(unsigned int i(0); i != theAdjoiningVoxelSize; ++i)
         {
-            const Voxel* adjoiningVoxel(aVoxel->adjoiningVoxels[i]);
+            const Voxel* adjoiningVoxel(getAdjoiningVoxel(aVoxel, i));
             const Point adjoiningPoint(coord2point(adjoiningVoxel->coord));
             const double distance_i(adjoiningPoint.y - aComp->centerPoint.y);
             if (distance_i > 0)
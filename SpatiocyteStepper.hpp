@@ -32,6 +32,7 @@
 #ifndef __SpatiocyteStepper_hpp
 #define __SpatiocyteStepper_hpp
 
+#include <pthread.h>
 #include <Stepper.hpp>
 #include "SpatiocyteCommon.hpp"
 
@@ -44,18 +45,55 @@ public:
       PROPERTYSLOT_SET_GET(Real, VoxelRadius);
       PROPERTYSLOT_SET_GET(Integer, LatticeType);
       PROPERTYSLOT_SET_GET(Integer, SearchVacant);
+      PROPERTYSLOT_SET_GET(Integer, ImplicitAdjoining);
+      PROPERTYSLOT_SET_GET(Integer, ThreadSize);
+      PROPERTYSLOT_SET_GET(Integer, RandomEngine);
+      PROPERTYSLOT_SET_GET(Integer, QueueArity);
+      PROPERTYSLOT_SET_GET(Integer, GroupReactions);
+      PROPERTYSLOT_SET_GET(Real, TauLeap);
+      PROPERTYSLOT_SET_GET(Integer, GroupDiffusion);
+      PROPERTYSLOT_SET_GET(Integer, SortInterval);
+      PROPERTYSLOT_SET_GET(String, LatticeFile);
+      PROPERTYSLOT_SET_GET(Integer, LatticeOrder);
     }
+  typedef void (*ThreadTask)(void*, unsigned int);
   SIMPLE_SET_GET_METHOD(Real, VoxelRadius); 
   SIMPLE_SET_GET_METHOD(Integer, LatticeType); 
   SIMPLE_SET_GET_METHOD(Integer, SearchVacant); 
+  SIMPLE_SET_GET_METHOD(Integer, ImplicitAdjoining); 
+  SIMPLE_SET_GET_METHOD(Integer, ThreadSize); 
+  SIMPLE_SET_GET_METHOD(Integer, RandomEngine); 
+  SIMPLE_SET_GET_METHOD(Integer, QueueArity); 
+  SIMPLE_SET_GET_METHOD(Integer, GroupReactions); 
+  SIMPLE_SET_GET_METHOD(Real, TauLeap); 
+  SIMPLE_SET_GET_METHOD(Integer, GroupDiffusion); 
+  SIMPLE_SET_GET_METHOD(Integer, SortInterval); 
+  SIMPLE_SET_GET_METHOD(String, LatticeFile); 
+  SIMPLE_SET_GET_METHOD(Integer, LatticeOrder); 
   SpatiocyteStepper():
     isInitialized(false),
     isPeriodicEdge(false),
+    GroupReactions(false),
+    GroupDiffusion(false),
     SearchVacant(false),
+    ImplicitAdjoining(false),
     LatticeType(HCP_LATTICE),
+    LatticeOrder(ROW_MAJOR_ORDER),
+    ThreadSize(1),
+    RandomEngine(GSL_RANDOM),
+    QueueArity(2),
+    SortInterval(0),
+    theInterruptStamp(1),
+    TauLeap(0),
+    theRandomSeed(0),
     VoxelRadius(10e-9),
-    theNormalizedVoxelRadius(0.5) {}
-  virtual ~SpatiocyteStepper() {}
+    theNormalizedVoxelRadius(0.5),
+    theThreadTask(NULL),
+    theThreadArgument(NULL),
+    theReactionGroup(NULL),
+    theTauLeapGroup(NULL),
+    theLoadedAdjoiningVoxels(NULL) {}
+  virtual ~SpatiocyteStepper();
   virtual void initialize();
   // need to check interrupt when we suddenly stop the simulation, do we
   // need to update the priority queue?
@@ -68,13 +106,16 @@ public:
   Point coord2point(unsigned int);
   void optimizeSurfaceVoxel(Voxel*, Comp*);
   void setSurfaceSubunit(Voxel*, Comp*);
+  void growCompartment(Comp*, unsigned int, unsigned int);
   Species* id2species(unsigned short);
   Comp* id2Comp(unsigned short);
   Voxel* coord2voxel(unsigned int);
+  unsigned int coord2index(unsigned int);
   Comp* system2Comp(System*);
   bool isBoundaryCoord(unsigned int, bool);
-  Voxel* getPeriodicVoxel(unsigned int, bool, Origin*);
-  Point getPeriodicPoint(unsigned int, bool, Origin*);
+  Voxel* getPeriodicVoxel(unsigned int, bool);
+  Point global2point(int, int, int);
+  void initDisplacement(const Voxel*, Displacement&);
   void checkLattice();
   void setPeriodicEdge();
   void reset(int);
@@ -88,7 +129,205 @@ public:
   Voxel* point2voxel(Point);
   std::vector<Comp*> const& getComps() const;
   Species* variable2species(Variable*);
+  //The species ID of a voxel is kept in a dense array separate from the
+  //Voxel topology to keep the walk cache friendly:
+  unsigned short getID(const Voxel* aVoxel) const
+    {
+      return theIDs[aVoxel-&theLattice[0]];
+    }
+  //The vacant voxels of each Comp and the molecules of each diffuse vacant
+  //species are tracked through here, which is why the ID must never be
+  //written directly:
+  void setID(const Voxel* aVoxel, unsigned short anID)
+    {
+      const unsigned int anIndex(aVoxel-&theLattice[0]);
+      if(theVoxelLists[theIDs[anIndex]])
+        {
+          removeListVoxel(*theVoxelLists[theIDs[anIndex]], anIndex);
+        }
+      theIDs[anIndex] = anID;
+      std::vector<Voxel*>* aList(theVoxelLists[anID]);
+      if(aList)
+        {
+          theMoleculeIndices[anIndex] = aList->size();
+          aList->push_back(&theLattice[anIndex]);
+        }
+    }
+  //Swaps the IDs of the molecules at aSource and aTarget. The tracked list
+  //entries are updated in place, so threads walking different sectors can
+  //call this concurrently. The molecule index of an untracked molecule at
+  //aSource is left to its species, which sets it with setMolecule:
+  void swapID(const Voxel* aSource, const Voxel* aTarget)
+    {
+      const unsigned int aSourceIndex(aSource-&theLattice[0]);
+      const unsigned int aTargetIndex(aTarget-&theLattice[0]);
+      const unsigned short aSourceID(theIDs[aSourceIndex]);
+      const unsigned short aTargetID(theIDs[aTargetIndex]);
+      theIDs[aSourceIndex] = aTargetID;
+      theIDs[aTargetIndex] = aSourceID;
+      const unsigned int aTargetListIndex(theMoleculeIndices[aTargetIndex]);
+      std::vector<Voxel*>* aList(theVoxelLists[aSourceID]);
+      if(aList)
+        {
+          const unsigned int aSourceListIndex(
+                                 theMoleculeIndices[aSourceIndex]);
+          (*aList)[aSourceListIndex] = &theLattice[aTargetIndex];
+          theMoleculeIndices[aTargetIndex] = aSourceListIndex;
+        }
+      aList = theVoxelLists[aTargetID];
+      if(aList)
+        {
+          (*aList)[aTargetListIndex] = &theLattice[aSourceIndex];
+          theMoleculeIndices[aSourceIndex] = aTargetListIndex;
+        }
+    }
+  //Adds the step of a molecule from aSource to aTarget to its unwrapped
+  //global coordinates. The step is taken separately along each axis, so
+  //that a step across a periodic plane joined by concatenatePeriodicSurfaces
+  //can be folded back into a single voxel step:
+  void addDisplacement(const Voxel* aSource, const Voxel* aTarget,
+                       Displacement& aDisplacement) const
+    {
+      const unsigned int aLayerRowSize(theRowSize*theLayerSize);
+      const unsigned int aSourceCoord(aSource->coord-theStartCoord);
+      const unsigned int aTargetCoord(aTarget->coord-theStartCoord);
+      const unsigned int aSourceRest(aSourceCoord%aLayerRowSize);
+      const unsigned int aTargetRest(aTargetCoord%aLayerRowSize);
+      aDisplacement.row += foldStep(int(aTargetRest%theRowSize)-
+                                    int(aSourceRest%theRowSize), theRowSize);
+      aDisplacement.layer += foldStep(int(aTargetRest/theRowSize)-
+                                      int(aSourceRest/theRowSize),
+                                      theLayerSize);
+      aDisplacement.col += foldStep(int(aTargetCoord/aLayerRowSize)-
+                                    int(aSourceCoord/aLayerRowSize),
+                                    theColSize);
+    }
+  //The voxels at the two ends of a periodic axis of aSize voxels are
+  //merged, so the axis repeats every aSize-1 voxels, and a step is folded
+  //into (-(aSize-1)/2, (aSize-1)/2]:
+  static int foldStep(int aStep, int aSize)
+    {
+      const int aPeriod(aSize-1);
+      if(2*aStep > aPeriod)
+        {
+          return aStep-aPeriod;
+        }
+      if(2*aStep <= -aPeriod)
+        {
+          return aStep+aPeriod;
+        }
+      return aStep;
+    }
+  //Only valid with a periodic edge, after setBoundaryFlags:
+  bool isBoundaryVoxel(const Voxel* aVoxel, bool isVolume) const
+    {
+      return theBoundaryFlags[aVoxel-&theLattice[0]] &
+        (isVolume ? VOLUME_BOUNDARY : SURFACE_BOUNDARY);
+    }
+  //The index of a molecule in the molecule list of its species is kept for
+  //every voxel so that the molecule can be removed in constant time. For a
+  //vacant voxel of a Comp, it is the index in Comp::vacantVoxels:
+  unsigned int getMoleculeIndex(const Voxel* aVoxel) const
+    {
+      return theMoleculeIndices[aVoxel-&theLattice[0]];
+    }
+  void setMoleculeIndex(const Voxel* aVoxel, unsigned int anIndex)
+    {
+      theMoleculeIndices[aVoxel-&theLattice[0]] = anIndex;
+    }
+  //The processes interrupted by the reactions that occur together, such as
+  //in a walk, are collected here and notified once each by
+  //notifyInterrupts. A process is only added if it has not been stamped
+  //with the current stamp:
+  unsigned int getInterruptStamp() const
+    {
+      return theInterruptStamp;
+    }
+  void addInterrupt(SpatiocyteProcessInterface* aProcess)
+    {
+      theInterrupts.push_back(aProcess);
+    }
+  void notifyInterrupts();
+  //The collision table holds an entry for every pair of a walking species
+  //and a target species, so that the walk finds both the reaction and its
+  //probability in one contiguous row:
+  CollisionEntry* getCollisionRow(unsigned short anID)
+    {
+      return &theCollisionTable[anID*theSpecies.size()];
+    }
+  //The lattice is split into 2*ThreadSize sectors along the column axis
+  //for the threaded walk. Thread i walks the molecules in sector 2i and then
+  //sector 2i+1, so that two threads never access the same voxel:
+  unsigned int getSector(const Voxel* aVoxel) const
+    {
+      return theColSectors[(aVoxel->coord-theStartCoord)/
+        (theRowSize*theLayerSize)];
+    }
+  //The index in theLattice of the voxel at the given global row, layer and
+  //column. With the MORTON_ORDER LatticeOrder, the bricks of
+  //LATTICE_BRICK_SIZE^3 voxels are stored one after another and the voxels
+  //within a brick follow the Morton (Z-order) curve, so most adjoining
+  //voxels are stored close together:
+  unsigned int global2index(unsigned int aRow, unsigned int aLayer,
+                            unsigned int aCol) const
+    {
+      if(LatticeOrder == ROW_MAJOR_ORDER)
+        {
+          return aRow+theRowSize*aLayer+theRowSize*theLayerSize*aCol;
+        }
+      return (aRow/LATTICE_BRICK_SIZE+theBrickRowSize*(
+              aLayer/LATTICE_BRICK_SIZE+theBrickLayerSize*(
+              aCol/LATTICE_BRICK_SIZE)))*
+        LATTICE_BRICK_SIZE*LATTICE_BRICK_SIZE*LATTICE_BRICK_SIZE+
+        (getMortonBits(aRow%LATTICE_BRICK_SIZE) |
+         getMortonBits(aLayer%LATTICE_BRICK_SIZE) << 1 |
+         getMortonBits(aCol%LATTICE_BRICK_SIZE) << 2);
+    }
+  gsl_rng* getThreadRng(unsigned int aThread)
+    {
+      return theThreadRngs[aThread];
+    }
+  void runThreads(ThreadTask, void*);
+  void initRandom(RandomBuffer&, unsigned int, unsigned int);
+  void waitThreads();
+  //With ImplicitAdjoining, only the voxels at the lattice boundary and the
+  //surface voxels keep an explicit adjoiningVoxels array. The adjoining
+  //voxels of the remaining (volume) voxels are computed from the fixed
+  //offsets of the lattice, which only depend on the parity of the layer
+  //and column of the voxel:
+  Voxel* getAdjoiningVoxel(Voxel* aVoxel, unsigned int anIndex)
+    {
+      if(aVoxel->adjoiningVoxels)
+        {
+          return aVoxel->adjoiningVoxels[anIndex];
+        }
+      return aVoxel+theAdjoiningOffsets[theAdjoiningClasses[
+        (aVoxel-&theLattice[0])/theRowSize]*theAdjoiningVoxelSize+anIndex];
+    }
+  //Returns the surface voxel list of the given type (INNER, OUTER,
+  //IMMEDIATE or EXTENDED) of aVoxel, with aSize voxels:
+  Voxel** getSurfaceVoxels(const Voxel* aVoxel, unsigned int aType,
+                           unsigned int& aSize)
+    {
+      return getSurfaceList(aType, aVoxel->surfaceIndex, aSize);
+    }
+  //Returns the immediate surface voxels of aVoxel that are shared with its
+  //extended surface voxel at anExtendedIndex of the EXTENDED list:
+  Voxel** getSharedVoxels(const Voxel* aVoxel, unsigned int anExtendedIndex,
+                          unsigned int& aSize)
+    {
+      return getSurfaceList(SHARED, theSurfaceVoxels.offsets[EXTENDED][
+                            aVoxel->surfaceIndex]+anExtendedIndex, aSize);
+    }
 private:
+  //The Comp coords found by a thread while compartmentalizing its range of
+  //columns, indexed by the vacant ID of the Comp, and the surface coords
+  //that update the dimensions of their Comp:
+  struct LatticeChunk
+    {
+      std::vector<std::vector<unsigned int> > coords;
+      std::vector<std::pair<Comp*, unsigned int> > surfaceCoords;
+    };
   void setCompsCenterPoint();
   void setIntersectingCompartmentList();
   void setIntersectingParent();
@@ -98,6 +337,7 @@ private:
   void shuffleAdjoiningVoxels();
   void setLatticeProperties();
   void initPriorityQueue();
+  void setInterrupts();
   void initProcessSecond();
   void initProcessThird();
   void initProcessFourth();
@@ -108,7 +348,28 @@ private:
   void initSpecies();
   void readjustSurfaceBoundarySizes();
   void constructLattice();
+  static void initVoxels(void*, unsigned int);
+  void initVoxels(unsigned int);
+  static void allocateBricks(void*, unsigned int);
+  void allocateBricks(unsigned int);
+  unsigned int getBrick(unsigned int, unsigned int, unsigned int);
+  bool isConcatenatedBrick(unsigned int, unsigned int, unsigned int);
+  bool hasConcatenatedBrick(unsigned int, unsigned int, unsigned int);
+  static void concatenateVoxels(void*, unsigned int);
+  void concatenateVoxels(unsigned int);
   void compartmentalizeLattice();
+  static void compartmentalizeVoxels(void*, unsigned int);
+  void compartmentalizeVoxels(unsigned int);
+  void getThreadRange(unsigned int, unsigned int, unsigned int*,
+                      unsigned int*);
+  //Spreads the three bits of a brick row, layer or column to the bits 0, 3
+  //and 6 of its Morton code:
+  static unsigned int getMortonBits(unsigned int aValue)
+    {
+      return (aValue&1) | (aValue&2) << 2 | (aValue&4) << 4;
+    }
+  double getWallTime();
+  void addInitTime(String const&, double*);
   void concatenatePeriodicSurfaces();
   void registerComps();
   void setCompsProperties();
@@ -128,6 +389,30 @@ private:
   void setLineVoxelProperties(Comp*);
   void setLineCompProperties(Comp*);
   void setSurfaceVoxelProperties(Comp*);
+  static void setSurfaceVoxels(void*, unsigned int);
+  void setSurfaceVoxels(Comp*, unsigned int);
+  void setImmediateSurfaceVoxels(Voxel*, Comp*, SurfaceVoxels&);
+  void setExtendedSurfaceVoxels(Voxel*, Comp*, SurfaceVoxels&, unsigned int);
+  void initSurfaceVoxels();
+  void clearSurfaceVoxels(SurfaceVoxels&);
+  void addSurfaceVoxels(SurfaceVoxels&);
+  void compactSurfaceVoxels();
+  void growCompGeometry(Comp*, unsigned int, unsigned int);
+  void setGrownSurfaceVoxels(unsigned int, unsigned int, unsigned int,
+                             unsigned int, unsigned int, unsigned int);
+  Comp* getOwnerComp(unsigned short);
+  bool isGrowingComp(Comp*, std::vector<Comp*> const&);
+  Voxel** getSurfaceList(unsigned int aType, unsigned int anIndex,
+                         unsigned int& aSize)
+    {
+      const unsigned int aBegin(theSurfaceVoxels.offsets[aType][anIndex]);
+      aSize = theSurfaceVoxels.offsets[aType][anIndex+1]-aBegin;
+      if(!aSize)
+        {
+          return NULL;
+        }
+      return &theSurfaceVoxels.voxels[aType][aBegin];
+    }
   void setSurfaceCompProperties(Comp*);
   void setVolumeCompProperties(Comp*);
   void rotateX(double, Point*);
@@ -137,13 +422,38 @@ private:
   void concatenateLayers(Voxel*, unsigned int, unsigned int, unsigned int);
   void concatenateRows(Voxel*, unsigned int, unsigned int, unsigned int);
   void concatenateCols(Voxel*, unsigned int, unsigned int, unsigned int);
+  void initThreads();
+  void finalizeThreads();
+  void setThreadRngs(unsigned long int);
+  static void* runThread(void*);
+  void setAdjoiningOffsets();
+  void setAdjoiningVoxels(Voxel*);
+  void getAdjoiningDisplacement(unsigned int, unsigned int, int*, int*, int*);
+  bool isExplicitAdjoiningCoord(unsigned int);
   void coord2global(unsigned int, unsigned int*, unsigned int*, unsigned int*);
+  void initVacantVoxels();
+  void clearDiffusionGroups();
+  void setCompActualSizes();
+  bool loadLattice();
+  void saveLattice();
+  void clearLattice();
+  void setLoadedCompVoxelProperties();
+  unsigned long long getGeometryHash();
+  void removeListVoxel(std::vector<Voxel*>& aList, unsigned int anIndex)
+    {
+      Voxel* aVoxel(aList.back());
+      const unsigned int aListIndex(theMoleculeIndices[anIndex]);
+      aList[aListIndex] = aVoxel;
+      theMoleculeIndices[aVoxel-&theLattice[0]] = aListIndex;
+      aList.pop_back();
+    }
   void replaceVoxel(Voxel*, Voxel*);
   void replaceUniVoxel(Voxel*, Voxel*);
   void setMinMaxSurfaceDimensions(unsigned int, Comp*);
   bool isRemovableEdgeCoord(unsigned int, Comp*);
   bool isInsideCoord(unsigned int, Comp*, double);
   bool isPeriodicEdgeCoord(unsigned int, Comp*);
+  void setBoundaryFlags();
   bool isSurfaceVoxel(Voxel*, Comp*);
   bool isLineVoxel(Voxel*, Comp*);
   bool isEnclosedSurfaceVoxel(Voxel*, Comp*);
@@ -152,7 +462,7 @@ private:
   bool isLowerPeerVoxel(Voxel*, Comp*);
   bool isRootSurfaceVoxel(Voxel*, Comp*);
   bool isParentSurfaceVoxel(Voxel*, Comp*);
-  bool compartmentalizeVoxel(Voxel*, Comp*);
+  bool compartmentalizeVoxel(Voxel*, Comp*, LatticeChunk&);
   double getCuboidSpecArea(Comp*);
   unsigned int coord2row(unsigned int);
   unsigned int coord2col(unsigned int);
@@ -162,27 +472,73 @@ private:
 private:
   bool isInitialized;
   bool isPeriodicEdge;
+  bool GroupReactions;
+  bool GroupDiffusion;
   bool SearchVacant;
+  bool ImplicitAdjoining;
   unsigned short theNullID;
   unsigned int LatticeType; 
+  unsigned int LatticeOrder; 
+  unsigned int ThreadSize;
+  unsigned int RandomEngine;
+  unsigned int QueueArity;
+  unsigned int SortInterval;
   unsigned int theAdjoiningVoxelSize;
   unsigned int theCellShape;
   unsigned int theStartCoord;
   unsigned int theRowSize;
   unsigned int theColSize;
   unsigned int theLayerSize;
+  unsigned int theBrickRowSize;
+  unsigned int theBrickColSize;
+  unsigned int theBrickLayerSize;
   unsigned int theBioSpeciesSize;
+  unsigned int theExplicitAdjoiningSize;
+  unsigned int theInterruptStamp;
+  //The epsilon of the tau-leaping of the HD reactions, disabled if 0:
+  double TauLeap;
+  unsigned long int theRandomSeed;
   double VoxelRadius; //r_v
   double theNormalizedVoxelRadius;
   double theHCPk;
   double theHCPh;
   double theHCPl;
   Point theCenterPoint;
+  String LatticeFile;
   ProcessPriorityQueue thePriorityQueue; 
   std::vector<Species*>::iterator variable2ispecies(Variable*);
   std::vector<Species*> theSpecies;
   std::vector<Comp*> theComps;
+  std::vector<Comp*> theVacantComps;
+  //The tracked voxel list of each ID, which is either Comp::vacantVoxels
+  //or the molecule list of a diffuse vacant species:
+  std::vector<std::vector<Voxel*>*> theVoxelLists;
   std::vector<Voxel> theLattice;
+  std::vector<unsigned short> theIDs;
+  std::vector<unsigned int> theMoleculeIndices;
+  std::vector<unsigned char> theBoundaryFlags;
+  std::vector<CollisionEntry> theCollisionTable;
+  std::vector<int> theAdjoiningOffsets;
+  std::vector<unsigned char> theAdjoiningClasses;
+  ThreadTask theThreadTask;
+  void* theThreadArgument;
+  pthread_barrier_t theThreadBarrier;
+  ReactionGroup* theReactionGroup;
+  TauLeapGroup* theTauLeapGroup;
+  //The explicit adjoiningVoxels arrays of a loaded lattice, in one block:
+  Voxel** theLoadedAdjoiningVoxels;
+  std::vector<DiffusionGroup*> theDiffusionGroups;
+  std::vector<pthread_t> theThreads;
+  std::vector<gsl_rng*> theThreadRngs;
+  std::vector<unsigned int> theColSectors;
+  std::vector<LatticeChunk> theLatticeChunks;
+  SurfaceVoxels theSurfaceVoxels;
+  std::vector<SurfaceVoxels> theSurfaceChunks;
+  std::vector<Voxel**> theLatticeBricks;
+  std::vector<unsigned char> theConcatenatedBricks;
+  std::vector<unsigned char> theConcatenatedVoxels;
+  std::vector<std::pair<String, double> > theInitTimes;
+  std::vector<SpatiocyteProcessInterface*> theInterrupts;
 };
 
 #endif /* __SpatiocyteStepper_hpp */
@@ -0,0 +1,500 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+//
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+
+#ifndef __TauLeapGroup_hpp
+#define __TauLeapGroup_hpp
+
+#include <climits>
+#include <algorithm>
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <Process.hpp>
+#include "SpatiocyteCommon.hpp"
+#include "SpatiocyteProcessInterface.hpp"
+#include "SpatiocyteNextReactionProcessInterface.hpp"
+
+//The SpatiocyteNextReactionProcesses whose reactants and products are all
+//HD variables share a single entry in the priority queue and are fired
+//together with the adaptive tau-leaping method of Cao, Gillespie and
+//Petzold (J. Chem. Phys., 2006). The leap is selected so that the
+//expected relative change of the propensities is bounded by epsilon, the
+//SpatiocyteStepper TauLeap. The reactions that would exhaust a reactant
+//within TAU_LEAP_CRITICAL_SIZE firings are critical and only fired once at
+//a time, and exact SSA steps are taken when the leap is too short to be
+//worthwhile, i.e., when the populations are small.
+//The firings of a leap are drawn when it is planned and executed at its
+//end. When a variable of the group is changed by another process before
+//then, the firings that have occurred until the current time are thinned
+//from the planned firings, which is exact for Poisson firings, and a new
+//leap is planned from the current state.
+class TauLeapGroup: public SpatiocyteProcessInterface
+{
+public:
+  TauLeapGroup(const gsl_rng* aRng, double anEpsilon):
+    isFiring(false),
+    theCriticalIndex(UINT_MAX),
+    thePriority(INT_MIN),
+    theEpsilon(anEpsilon),
+    theLeap(0),
+    thePlanTime(0),
+    theTime(libecs::INF),
+    theRng(aRng),
+    thePriorityQueue(NULL) {}
+  virtual ~TauLeapGroup() {}
+  virtual void initializeSecond() {}
+  virtual void initializeThird() {}
+  virtual void initializeFourth() {}
+  virtual void initializeLastOnce() {}
+  virtual void printParameters()
+    {
+      std::cout << "TauLeapGroup" << std::endl;
+      std::cout << "  reactions:" << theReactions.size() << " variables:" <<
+        theVariables.size() << " epsilon:" << theEpsilon << std::endl;
+    }
+  virtual void substrateValueChanged(Time) {}
+  virtual void setPriorityQueue(ProcessPriorityQueue* aPriorityQueue)
+    {
+      thePriorityQueue = aPriorityQueue;
+    }
+  virtual void setTime(Time aTime)
+    {
+      theTime = aTime;
+    }
+  virtual Time getTime() const
+    {
+      return theTime;
+    }
+  //The group is executed with the highest priority of its processes at
+  //the same time:
+  virtual int getQueuePriority() const
+    {
+      return thePriority;
+    }
+  virtual void setQueueID(ProcessID anID)
+    {
+      theQueueID = anID;
+    }
+  virtual void addSubstrateInterrupt(Species*, Voxel*) {}
+  virtual void removeSubstrateInterrupt(Species*, Voxel*) {}
+  bool isEmpty() const
+    {
+      return theReactions.empty();
+    }
+  void addReaction(SpatiocyteNextReactionProcessInterface* aReaction,
+                   Process* aProcess)
+    {
+      const unsigned int anIndex(theReactions.size());
+      aReaction->setTauLeapGroup(this, anIndex);
+      theReactions.push_back(aReaction);
+      thePropensities.push_back(0);
+      theFirings.push_back(0);
+      isCriticals.push_back(false);
+      addPriority(dynamic_cast<SpatiocyteProcessInterface*>(aProcess));
+      theChangeVariables.resize(anIndex+1);
+      theChangeCoefficients.resize(anIndex+1);
+      VariableReferenceVector const& aVariableReferences(
+                                         aProcess->getVariableReferenceVector());
+      std::vector<unsigned int> aReactants;
+      std::vector<int> aReactantCoefficients;
+      int anOrder(0);
+      for(VariableReferenceVector::const_iterator i(
+          aVariableReferences.begin()); i != aVariableReferences.end(); ++i)
+        {
+          const unsigned int aVariable(getVariableIndex(i->getVariable()));
+          const int aCoefficient(i->getCoefficient());
+          addCoefficient(theChangeVariables[anIndex],
+                         theChangeCoefficients[anIndex], aVariable,
+                         aCoefficient);
+          if(aCoefficient < 0)
+            {
+              anOrder -= aCoefficient;
+              addCoefficient(aReactants, aReactantCoefficients, aVariable,
+                             -aCoefficient);
+            }
+        }
+      //The highest order of the reactions of each reactant, and whether
+      //it is consumed twice by such a reaction, for the leap condition:
+      for(unsigned int i(0); i != aReactants.size(); ++i)
+        {
+          const unsigned int aVariable(aReactants[i]);
+          if(anOrder > theHighestOrders[aVariable])
+            {
+              theHighestOrders[aVariable] = anOrder;
+              isHighestOrderDimers[aVariable] = false;
+            }
+          if(anOrder == theHighestOrders[aVariable] &&
+             aReactantCoefficients[i] > 1)
+            {
+              isHighestOrderDimers[aVariable] = true;
+            }
+        }
+    }
+  //Must be called before the group is pushed into the priority queue:
+  void initialize(Time aCurrentTime)
+    {
+      plan(aCurrentTime);
+    }
+  //Called by the reactions of the group when their substrates have been
+  //changed by another process:
+  void update(unsigned int, Time aCurrentTime)
+    {
+      //The reactions of the group are notified of their own firings:
+      if(isFiring)
+        {
+          return;
+        }
+      //Several reactions of the group may be notified of the same change,
+      //which needs only a single plan:
+      if(aCurrentTime == thePlanTime && isUnchanged())
+        {
+          return;
+        }
+      if(aCurrentTime > thePlanTime && theLeap > 0)
+        {
+          thinFirings((aCurrentTime-thePlanTime)/theLeap);
+          fireFirings(aCurrentTime, UINT_MAX);
+        }
+      plan(aCurrentTime);
+      thePriorityQueue->move(theQueueID);
+    }
+  virtual void fire()
+    {
+      const Time aCurrentTime(theTime);
+      fireFirings(aCurrentTime, theCriticalIndex);
+      plan(aCurrentTime);
+      thePriorityQueue->moveTop();
+    }
+private:
+  void addPriority(SpatiocyteProcessInterface* aProcess)
+    {
+      if(aProcess && aProcess->getQueuePriority() > thePriority)
+        {
+          thePriority = aProcess->getQueuePriority();
+        }
+    }
+  unsigned int getVariableIndex(Variable* aVariable)
+    {
+      const unsigned int anIndex(std::find(theVariables.begin(),
+                   theVariables.end(), aVariable)-theVariables.begin());
+      if(anIndex == theVariables.size())
+        {
+          theVariables.push_back(aVariable);
+          theValues.push_back(0);
+          theNewValues.push_back(0);
+          theHighestOrders.push_back(0);
+          isHighestOrderDimers.push_back(false);
+          theMeans.push_back(0);
+          theVariances.push_back(0);
+        }
+      return anIndex;
+    }
+  void addCoefficient(std::vector<unsigned int>& aVariables,
+                      std::vector<int>& aCoefficients,
+                      unsigned int aVariable, int aCoefficient)
+    {
+      const unsigned int anIndex(std::find(aVariables.begin(),
+                     aVariables.end(), aVariable)-aVariables.begin());
+      if(anIndex == aVariables.size())
+        {
+          aVariables.push_back(aVariable);
+          aCoefficients.push_back(aCoefficient);
+        }
+      else
+        {
+          aCoefficients[anIndex] += aCoefficient;
+        }
+    }
+  //Draws the firings of the next leap, or of the next SSA step, from the
+  //current state:
+  void plan(Time aCurrentTime)
+    {
+      thePlanTime = aCurrentTime;
+      theCriticalIndex = UINT_MAX;
+      std::fill(theFirings.begin(), theFirings.end(), 0);
+      for(unsigned int i(0); i != theVariables.size(); ++i)
+        {
+          theValues[i] = theVariables[i]->getValue();
+        }
+      double aTotalPropensity(0);
+      double aCriticalPropensity(0);
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          isCriticals[i] = false;
+          thePropensities[i] = theReactions[i]->getGroupPropensity();
+          aTotalPropensity += thePropensities[i];
+          if(thePropensities[i] > 0 && isCritical(i))
+            {
+              isCriticals[i] = true;
+              aCriticalPropensity += thePropensities[i];
+            }
+        }
+      if(aTotalPropensity <= 0)
+        {
+          theLeap = 0;
+          theTime = libecs::INF;
+          return;
+        }
+      double aLeap(getNonCriticalLeap());
+      while(true)
+        {
+          //All reactions are critical when the leap is unbounded:
+          if(aLeap == libecs::INF ||
+             aLeap < TAU_LEAP_SSA_FACTOR/aTotalPropensity)
+            {
+              theLeap = 0;
+              theTime = aCurrentTime-
+                log(gsl_rng_uniform_pos(theRng))/aTotalPropensity;
+              theCriticalIndex = selectReaction(aTotalPropensity, false);
+              return;
+            }
+          theLeap = aLeap;
+          theCriticalIndex = UINT_MAX;
+          if(aCriticalPropensity > 0)
+            {
+              const double aCriticalLeap(
+                 -log(gsl_rng_uniform_pos(theRng))/aCriticalPropensity);
+              if(aCriticalLeap <= aLeap)
+                {
+                  theLeap = aCriticalLeap;
+                  theCriticalIndex = selectReaction(aCriticalPropensity, true);
+                }
+            }
+          for(unsigned int i(0); i != theReactions.size(); ++i)
+            {
+              theFirings[i] = 0;
+              if(!isCriticals[i] && thePropensities[i] > 0)
+                {
+                  theFirings[i] = gsl_ran_poisson(theRng,
+                                                  thePropensities[i]*theLeap);
+                }
+            }
+          if(getNegativeVariable(theCriticalIndex) == UINT_MAX)
+            {
+              theTime = aCurrentTime+theLeap;
+              return;
+            }
+          //A reactant would become negative, so retry with a shorter leap:
+          aLeap /= 2;
+        }
+    }
+  //The leap that bounds the expected relative change of the propensities
+  //of the non-critical reactions:
+  double getNonCriticalLeap()
+    {
+      std::fill(theMeans.begin(), theMeans.end(), 0);
+      std::fill(theVariances.begin(), theVariances.end(), 0);
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          if(isCriticals[i] || thePropensities[i] <= 0)
+            {
+              continue;
+            }
+          for(unsigned int j(0); j != theChangeVariables[i].size(); ++j)
+            {
+              const double aChange(theChangeCoefficients[i][j]);
+              theMeans[theChangeVariables[i][j]] += aChange*thePropensities[i];
+              theVariances[theChangeVariables[i][j]] +=
+                aChange*aChange*thePropensities[i];
+            }
+        }
+      double aLeap(libecs::INF);
+      for(unsigned int i(0); i != theVariables.size(); ++i)
+        {
+          //The products that are not reactants of any reaction are also
+          //bounded, as first order reactants, so that their values are
+          //not left behind by very long leaps:
+          double anOrder(std::max(theHighestOrders[i], 1));
+          if(isHighestOrderDimers[i] && theValues[i] > 1)
+            {
+              anOrder += 1/(theValues[i]-1);
+            }
+          const double aBound(std::max(theEpsilon*theValues[i]/anOrder, 1.0));
+          if(theMeans[i] != 0)
+            {
+              aLeap = std::min(aLeap, aBound/fabs(theMeans[i]));
+            }
+          if(theVariances[i] > 0)
+            {
+              aLeap = std::min(aLeap, aBound*aBound/theVariances[i]);
+            }
+        }
+      return aLeap;
+    }
+  bool isCritical(unsigned int anIndex)
+    {
+      for(unsigned int i(0); i != theChangeVariables[anIndex].size(); ++i)
+        {
+          const int aChange(theChangeCoefficients[anIndex][i]);
+          if(aChange < 0 && theValues[theChangeVariables[anIndex][i]] <
+             -aChange*TAU_LEAP_CRITICAL_SIZE)
+            {
+              return true;
+            }
+        }
+      return false;
+    }
+  unsigned int selectReaction(double aTotalPropensity, bool isCriticalOnly)
+    {
+      double aValue(gsl_rng_uniform(theRng)*aTotalPropensity);
+      unsigned int aLast(0);
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          if((!isCriticalOnly || isCriticals[i]) && thePropensities[i] > 0)
+            {
+              if(aValue < thePropensities[i])
+                {
+                  return i;
+                }
+              aValue -= thePropensities[i];
+              aLast = i;
+            }
+        }
+      //Because of the rounding errors:
+      return aLast;
+    }
+  bool isUnchanged() const
+    {
+      for(unsigned int i(0); i != theVariables.size(); ++i)
+        {
+          if(theVariables[i]->getValue() != theValues[i])
+            {
+              return false;
+            }
+        }
+      return true;
+    }
+  //Returns a variable that would become negative, or more negative if it
+  //already is, after the firings, or UINT_MAX if there is none:
+  unsigned int getNegativeVariable(unsigned int aCriticalIndex)
+    {
+      std::vector<double>& aValues(theNewValues);
+      aValues = theValues;
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          const double aFirings(i == aCriticalIndex ? theFirings[i]+1 :
+                                theFirings[i]);
+          if(aFirings)
+            {
+              for(unsigned int j(0); j != theChangeVariables[i].size(); ++j)
+                {
+                  aValues[theChangeVariables[i][j]] +=
+                    theChangeCoefficients[i][j]*aFirings;
+                }
+            }
+        }
+      for(unsigned int i(0); i != aValues.size(); ++i)
+        {
+          if(aValues[i] < std::min(theValues[i], 0.0))
+            {
+              return i;
+            }
+        }
+      return UINT_MAX;
+    }
+  //Keeps each planned firing with the probability of the elapsed fraction
+  //of the leap:
+  void thinFirings(double aFraction)
+    {
+      for(unsigned int i(0); i != theFirings.size(); ++i)
+        {
+          if(theFirings[i])
+            {
+              theFirings[i] = gsl_ran_binomial(theRng, std::min(aFraction, 1.0),
+                                               theFirings[i]);
+            }
+        }
+      //The variables have been changed by another process since the plan,
+      //and a reactant may also become negative if only its consumption was
+      //kept. The firings of the reactions that consume a variable that
+      //would become negative are dropped until none is left:
+      for(unsigned int i(0); i != theVariables.size(); ++i)
+        {
+          theValues[i] = theVariables[i]->getValue();
+        }
+      unsigned int aVariable(getNegativeVariable(UINT_MAX));
+      while(aVariable != UINT_MAX)
+        {
+          for(unsigned int i(0); i != theReactions.size(); ++i)
+            {
+              for(unsigned int j(0); theFirings[i] &&
+                  j != theChangeVariables[i].size(); ++j)
+                {
+                  if(theChangeVariables[i][j] == aVariable &&
+                     theChangeCoefficients[i][j] < 0)
+                    {
+                      theFirings[i] = 0;
+                    }
+                }
+            }
+          aVariable = getNegativeVariable(UINT_MAX);
+        }
+    }
+  void fireFirings(Time aCurrentTime, unsigned int aCriticalIndex)
+    {
+      isFiring = true;
+      for(unsigned int i(0); i != theReactions.size(); ++i)
+        {
+          const unsigned int aFirings(i == aCriticalIndex ? theFirings[i]+1 :
+                                      theFirings[i]);
+          if(aFirings)
+            {
+              theReactions[i]->fireLeap(aCurrentTime, aFirings);
+            }
+        }
+      isFiring = false;
+    }
+private:
+  bool isFiring;
+  unsigned int theCriticalIndex;
+  int thePriority;
+  const double theEpsilon;
+  double theLeap;
+  Time thePlanTime;
+  Time theTime;
+  const gsl_rng* theRng;
+  ProcessID theQueueID;
+  ProcessPriorityQueue* thePriorityQueue;
+  std::vector<SpatiocyteNextReactionProcessInterface*> theReactions;
+  std::vector<double> thePropensities;
+  std::vector<unsigned int> theFirings;
+  std::vector<bool> isCriticals;
+  std::vector<std::vector<unsigned int> > theChangeVariables;
+  std::vector<std::vector<int> > theChangeCoefficients;
+  std::vector<Variable*> theVariables;
+  std::vector<double> theValues;
+  std::vector<double> theNewValues;
+  std::vector<int> theHighestOrders;
+  std::vector<bool> isHighestOrderDimers;
+  std::vector<double> theMeans;
+  std::vector<double> theVariances;
+};
+
+#endif /* __TauLeapGroup_hpp */
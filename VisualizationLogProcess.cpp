@@ -78,10 +78,11 @@ void VisualizationLogProcess::initializeLog()
       unsigned int aPolymerIndex(thePolymerIndex[i]);
       theLogFile.write((char*) (&aPolymerIndex), sizeof(aPolymerIndex));
     }
-  //a, b, c are used for multithreaded simulation which is
-  //not implemented yet.
-  //The visualizer assumes multithreaded data, so we need to initialize the 
-  //logger with the expected values for a single threaded simulation.
+  //a, b, c are the column boundaries of the region logged by each log
+  //stream. The walk may be split among the column sectors of
+  //SpatiocyteStepper (ThreadSize > 1), but the molecules of all sectors are
+  //still logged into this single stream, so we write the values of a single
+  //region that covers the whole lattice:
   unsigned int a(aStartCoord-1);
   unsigned int c(a+aRowSize*aLayerSize*aColSize);
   unsigned int b(c-aRowSize*aLayerSize*0);
@@ -246,11 +247,11 @@ void VisualizationLogProcess::logSurfaceVoxels()
           //The species molecule size:
           unsigned int aSize(aSurface->coords.size());
           theLogFile.write((char*)(&aSize), sizeof(aSize)); 
-          unsigned int aStartCoord(theSpatiocyteStepper->getStartCoord());
           for(std::vector<unsigned int>::const_iterator j(
                aSurface->coords.begin()); j != aSurface->coords.end(); ++j)
             {
-              unsigned int aCoord((*j)+aStartCoord);
+              unsigned int aCoord(
+                         theSpatiocyteStepper->coord2voxel(*j)->coord);
               theLogFile.write((char*)(&aCoord), sizeof(aCoord));
             }  
         }
@@ -0,0 +1,239 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+//Counts the heap allocations of the product placement of a
+//diffusion-influenced reaction, A + B -> C + D, with the std::vector
+//candidate lists of the old getRandomAdjoiningVoxel overloads (before) and
+//with the stack array of the current ones (after). The two selections are
+//copied from SpatiocyteSpecies.hpp onto a small periodic lattice with 12
+//adjoining voxels per voxel, since a Species needs a running model. Both
+//use the same random draws, so they must place the same products.
+//
+//  make bench && ./bench/AdjoiningVoxelBench
+
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <vector>
+
+#define MAX_ADJOINING_VOXEL_SIZE 12
+
+static unsigned long theNewCount(0);
+
+#if __cplusplus < 201103L
+void* operator new(std::size_t aSize) throw(std::bad_alloc)
+#else
+void* operator new(std::size_t aSize)
+#endif
+{
+  ++theNewCount;
+  void* aPointer(std::malloc(aSize ? aSize : 1));
+  if(!aPointer)
+    {
+      throw std::bad_alloc();
+    }
+  return aPointer;
+}
+
+#if __cplusplus < 201103L
+void operator delete(void* aPointer) throw()
+#else
+void operator delete(void* aPointer) noexcept
+#endif
+{
+  std::free(aPointer);
+}
+
+//The vacant voxels of the compartment have the ID 0, the molecules the
+//ID 1 and the voxels of another compartment the ID 2:
+class Lattice
+{
+public:
+  Lattice(unsigned int aSize):
+    theSize(aSize),
+    theIDs(aSize*aSize*aSize),
+    theAdjoiningVoxels(aSize*aSize*aSize*MAX_ADJOINING_VOXEL_SIZE)
+    {
+      const int anOffsets[MAX_ADJOINING_VOXEL_SIZE][3] = {
+          {1, 1, 0}, {1, -1, 0}, {-1, 1, 0}, {-1, -1, 0},
+          {1, 0, 1}, {1, 0, -1}, {-1, 0, 1}, {-1, 0, -1},
+          {0, 1, 1}, {0, 1, -1}, {0, -1, 1}, {0, -1, -1}};
+      for(unsigned int i(0); i != theIDs.size(); ++i)
+        {
+          const double aValue(std::rand()/(RAND_MAX+1.0));
+          theIDs[i] = aValue < 0.6 ? 0 : (aValue < 0.95 ? 1 : 2);
+          const int row(i%aSize);
+          const int col((i/aSize)%aSize);
+          const int layer(i/(aSize*aSize));
+          for(unsigned int j(0); j != MAX_ADJOINING_VOXEL_SIZE; ++j)
+            {
+              theAdjoiningVoxels[i*MAX_ADJOINING_VOXEL_SIZE+j] =
+                getCoord(row+anOffsets[j][0], col+anOffsets[j][1],
+                         layer+anOffsets[j][2]);
+            }
+        }
+    }
+  unsigned int size() const
+    {
+      return theIDs.size();
+    }
+  unsigned int getID(unsigned int aVoxel) const
+    {
+      return theIDs[aVoxel];
+    }
+  unsigned int getComp(unsigned int aVoxel) const
+    {
+      return theIDs[aVoxel] == 2;
+    }
+  unsigned int getAdjoiningVoxel(unsigned int aVoxel, unsigned int anIndex)
+    const
+    {
+      return theAdjoiningVoxels[aVoxel*MAX_ADJOINING_VOXEL_SIZE+anIndex];
+    }
+private:
+  unsigned int getCoord(int aRow, int aCol, int aLayer) const
+    {
+      const int aSize(theSize);
+      return ((aRow+aSize)%aSize)+((aCol+aSize)%aSize)*aSize+
+        ((aLayer+aSize)%aSize)*aSize*aSize;
+    }
+private:
+  const unsigned int theSize;
+  std::vector<unsigned char> theIDs;
+  std::vector<unsigned int> theAdjoiningVoxels;
+};
+
+static const unsigned int NO_VOXEL(0xFFFFFFFFU);
+
+static unsigned int uniformInt(unsigned int aSize)
+{
+  return static_cast<unsigned int>(std::rand()/(RAND_MAX+1.0)*aSize);
+}
+
+static unsigned int getRandomAdjoiningVoxelBefore(const Lattice& aLattice,
+                                                  unsigned int source,
+                                                  unsigned int target)
+{
+  std::vector<unsigned int> CompVoxels;
+  for(unsigned int i(0); i != MAX_ADJOINING_VOXEL_SIZE; ++i)
+    {
+      const unsigned int aVoxel(aLattice.getAdjoiningVoxel(source, i));
+      if(aLattice.getComp(aVoxel) == 0 && aVoxel != target)
+        {
+          CompVoxels.push_back(aVoxel);
+        }
+    }
+  if(CompVoxels.size())
+    {
+      const unsigned int aVoxel(CompVoxels[uniformInt(CompVoxels.size())]);
+      if(aLattice.getID(aVoxel) == 0)
+        {
+          return aVoxel;
+        }
+    }
+  return NO_VOXEL;
+}
+
+static unsigned int getRandomAdjoiningVoxelAfter(const Lattice& aLattice,
+                                                 unsigned int source,
+                                                 unsigned int target)
+{
+  unsigned int compVoxels[MAX_ADJOINING_VOXEL_SIZE];
+  unsigned int aSize(0);
+  for(unsigned int i(0); i != MAX_ADJOINING_VOXEL_SIZE; ++i)
+    {
+      const unsigned int aVoxel(aLattice.getAdjoiningVoxel(source, i));
+      if(aLattice.getComp(aVoxel) == 0 && aVoxel != target)
+        {
+          compVoxels[aSize++] = aVoxel;
+        }
+    }
+  if(aSize)
+    {
+      const unsigned int aVoxel(compVoxels[uniformInt(aSize)]);
+      if(aLattice.getID(aVoxel) == 0)
+        {
+          return aVoxel;
+        }
+    }
+  return NO_VOXEL;
+}
+
+typedef unsigned int (*Selector)(const Lattice&, unsigned int, unsigned int);
+
+//Places C next to A or else next to B, and then D next to C, as
+//DiffusionInfluencedReactionProcess::react does for A + B -> C + D.
+//Returns the number of reactions that placed both products:
+static unsigned int react(const Lattice& aLattice, Selector aSelector,
+                          unsigned int aReactionSize)
+{
+  std::srand(1);
+  unsigned int aPlacedSize(0);
+  for(unsigned int i(0); i != aReactionSize; ++i)
+    {
+      const unsigned int moleculeA(uniformInt(aLattice.size()));
+      const unsigned int moleculeB(aLattice.getAdjoiningVoxel(moleculeA,
+                                        uniformInt(MAX_ADJOINING_VOXEL_SIZE)));
+      unsigned int moleculeC(aSelector(aLattice, moleculeA, NO_VOXEL));
+      if(moleculeC == NO_VOXEL)
+        {
+          moleculeC = aSelector(aLattice, moleculeB, NO_VOXEL);
+          if(moleculeC == NO_VOXEL)
+            {
+              continue;
+            }
+        }
+      if(aSelector(aLattice, moleculeC, moleculeC) != NO_VOXEL)
+        {
+          ++aPlacedSize;
+        }
+    }
+  return aPlacedSize;
+}
+
+int main()
+{
+  const unsigned int aReactionSize(1000000);
+  std::srand(1);
+  const Lattice aLattice(64);
+  const char* aNames[2] = {"before", "after"};
+  const Selector aSelectors[2] = {&getRandomAdjoiningVoxelBefore,
+                                  &getRandomAdjoiningVoxelAfter};
+  for(unsigned int i(0); i != 2; ++i)
+    {
+      theNewCount = 0;
+      const unsigned int aPlacedSize(react(aLattice, aSelectors[i],
+                                           aReactionSize));
+      std::printf("%-6s: %.3f allocations per reaction, %u of %u placed\n",
+                  aNames[i], double(theNewCount)/aReactionSize, aPlacedSize,
+                  aReactionSize);
+    }
+  return 0;
+}
@@ -0,0 +1,132 @@
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//        This file is part of E-Cell Simulation Environment package
+//
+//                Copyright (C) 2006-2009 Keio University
+//
+//::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::
+//
+//
+// E-Cell is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+// 
+// E-Cell is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public
+// License along with E-Cell -- see the file COPYING.
+// If not, write to the Free Software Foundation, Inc.,
+// 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+// 
+//END_HEADER
+//
+// written by Satya Arjunan <satya.arjunan@gmail.com>
+// E-Cell Project, Institute for Advanced Biosciences, Keio University.
+//
+
+//Times the process queue of SpatiocyteStepper with the arities accepted by
+//the QueueArity property. Each step reschedules the top process, as
+//SpatiocyteStepper::step does, and then the time of a random process is
+//changed, as ReactionProcess::substrateValueChanged does for an
+//interrupted process. The arities must execute the processes in the same
+//order, which is checked by a sum over the executed sequence.
+//
+//  make bench ECELL3_PREFIX=<prefix of E-Cell> && ./bench/PriorityQueueBench
+
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+#include <vector>
+#include <libecs.hpp>
+#include "../PriorityQueue.hpp"
+
+class Event
+{
+public:
+  Event(unsigned int anID, double aTime, int aPriority):
+    theID(anID),
+    thePriority(aPriority),
+    theTime(aTime) {}
+  double getTime() const
+    {
+      return theTime;
+    }
+  void setTime(double aTime)
+    {
+      theTime = aTime;
+    }
+  int getQueuePriority() const
+    {
+      return thePriority;
+    }
+  unsigned int getID() const
+    {
+      return theID;
+    }
+private:
+  const unsigned int theID;
+  const int thePriority;
+  double theTime;
+};
+
+typedef PriorityQueue<Event*> EventQueue;
+
+static double getInterval()
+{
+  return -log((std::rand()+1.0)/(RAND_MAX+2.0));
+}
+
+//Returns the sum of the IDs of the executed events weighted by the step:
+static double run(unsigned int anArity, unsigned int anEventSize,
+                  unsigned int aStepSize, double& aSeconds)
+{
+  std::srand(1);
+  std::vector<Event*> anEvents;
+  std::vector<EventQueue::ID> anIDs;
+  EventQueue aQueue;
+  aQueue.setArity(anArity);
+  for(unsigned int i(0); i != anEventSize; ++i)
+    {
+      anEvents.push_back(new Event(i, getInterval(), std::rand()%3));
+      anIDs.push_back(aQueue.push(anEvents.back()));
+    }
+  double aSum(0);
+  const std::clock_t aStart(std::clock());
+  for(unsigned int i(0); i != aStepSize; ++i)
+    {
+      Event* anEvent(aQueue.getTop());
+      const double aTime(anEvent->getTime());
+      aSum += double(anEvent->getID())*(i%1024);
+      anEvent->setTime(aTime+getInterval());
+      aQueue.moveTop();
+      const unsigned int anIndex(std::rand()%anEventSize);
+      anEvents[anIndex]->setTime(aTime+getInterval());
+      aQueue.move(anIDs[anIndex]);
+    }
+  aSeconds = double(std::clock()-aStart)/CLOCKS_PER_SEC;
+  for(unsigned int i(0); i != anEventSize; ++i)
+    {
+      delete anEvents[i];
+    }
+  return aSum;
+}
+
+int main()
+{
+  const unsigned int anEventSize(5000);
+  const unsigned int aStepSize(5000000);
+  for(unsigned int anArity(2); anArity <= 8; anArity *= 2)
+    {
+      double aSeconds(0);
+      const double aSum(run(anArity, anEventSize, aStepSize, aSeconds));
+      std::printf("arity %u: %.2fs for %u steps over %u processes, "
+                  "order sum %.0f\n", anArity, aSeconds, aStepSize,
+                  anEventSize, aSum);
+    }
+  return 0;
+}